@@ -0,0 +1,221 @@
+#include "arena.hpp"
+
+#include <unordered_map>
+#include <new>
+
+
+TExprNode::TExprNode(const VectOfDouble& coeff_vect)
+    : IPolynomial(coeff_vect)
+{}
+
+TExprNode::TExprNode(Operation op, const TFunction& lhs, const TFunction& rhs)
+{
+    is_basic_ = false;
+    op_ = op;
+    lhs_ = &lhs;
+    rhs_ = &rhs;
+
+    get_val_ftor_ =
+    [this](double x)
+    {
+        return applyOperation(op_,
+                              lhs_->get_val_ftor_(x),
+                              rhs_->get_val_ftor_(x));
+    };
+
+    get_deriv_ftor_ =
+    [this](double x)
+    {
+        return applyOperation(op_,
+                              lhs_->get_val_deriv_ftor_(x),
+                              rhs_->get_val_deriv_ftor_(x)).deriv;
+    };
+
+    get_val_deriv_ftor_ =
+    [this](double x)
+    {
+        return applyOperation(op_,
+                              lhs_->get_val_deriv_ftor_(x),
+                              rhs_->get_val_deriv_ftor_(x));
+    };
+
+    // The operation is selected once per call, not once per point.
+    get_val_batch_ftor_ =
+    [this](const double* xs, double* out, std::size_t n)
+    {
+        visitOperation(op_,
+        [&](auto f)
+        {
+            evaluateBinaryBatch(*lhs_, *rhs_, f, xs, out, n);
+        });
+    };
+
+    get_val_deriv_batch_ftor_ =
+    [this](const double* xs,
+           double* val_out,
+           double* deriv_out,
+           std::size_t n)
+    {
+        visitOperation(op_,
+        [&](auto f)
+        {
+            evaluateBinaryValDerivBatch(*lhs_,
+                                        *rhs_,
+                                        f,
+                                        xs,
+                                        val_out,
+                                        deriv_out,
+                                        n);
+        });
+    };
+}
+
+
+TExprContext::TExprContext(std::size_t nodes_num)
+    : arena_ { std::max<std::size_t>(nodes_num, 1) * sizeof(TExprNode) }
+{}
+
+TExprContext::~TExprContext()
+{
+    // The arena frees the memory at once, but the functors and the
+    // coefficient vectors of the nodes have to be destroyed one by one.
+    while (nodes_ != nullptr) {
+        TExprNode* next = nodes_->next_;
+        nodes_->~TExprNode();
+        nodes_ = next;
+    }
+}
+
+template<class... TArgs>
+TExprNode& TExprContext::create(TArgs&&... args)
+{
+    void* mem = arena_.allocate(sizeof(TExprNode), alignof(TExprNode));
+    auto node = new (mem) TExprNode(std::forward<TArgs>(args)...);
+
+    node->next_ = nodes_;
+    nodes_ = node;
+    nodes_num_++;
+
+    return *node;
+}
+
+
+const IPolynomial& TExprContext::basic(const VectOfDouble& coeff_vect)
+{
+    auto it = leaves_.find(coeff_vect);
+    if (it != leaves_.end()) {
+        return *it->second;
+    }
+
+    const TExprNode& node = create(coeff_vect);
+    leaves_.emplace(coeff_vect, &node);
+
+    return node;
+}
+
+const IPolynomial& TExprContext::ident()
+{
+    return basic({ 0, 0, 1 });
+}
+
+const IPolynomial& TExprContext::constant(double c)
+{
+    return basic({ 0, c });
+}
+
+const IPolynomial& TExprContext::power(int n)
+{
+    VectOfDouble coeff_vect(n + 2, 0);
+    coeff_vect.back() = 1;
+
+    return basic(coeff_vect);
+}
+
+const IPolynomial& TExprContext::exp()
+{
+    return basic({ 1 });
+}
+
+const IPolynomial& TExprContext::polynomial(const VectOfDouble& coeffs)
+{
+    VectOfDouble coeff_vect = { 0 };
+    coeff_vect.insert(coeff_vect.end(), coeffs.begin(), coeffs.end());
+
+    return basic(coeff_vect);
+}
+
+
+const IPolynomial& TExprContext::binary(TFunction::Operation op,
+                                        const TFunction& lhs,
+                                        const TFunction& rhs)
+{
+    if (op == TFunction::Operation::None) {
+        throw std::logic_error("Error: Invalid operation");
+    }
+
+    return create(op, lhs, rhs);
+}
+
+const IPolynomial& TExprContext::add(const TFunction& lhs,
+                                     const TFunction& rhs)
+{
+    return create(TFunction::Operation::Add, lhs, rhs);
+}
+
+const IPolynomial& TExprContext::sub(const TFunction& lhs,
+                                     const TFunction& rhs)
+{
+    return create(TFunction::Operation::Sub, lhs, rhs);
+}
+
+const IPolynomial& TExprContext::mul(const TFunction& lhs,
+                                     const TFunction& rhs)
+{
+    return create(TFunction::Operation::Mul, lhs, rhs);
+}
+
+const IPolynomial& TExprContext::div(const TFunction& lhs,
+                                     const TFunction& rhs)
+{
+    return create(TFunction::Operation::Div, lhs, rhs);
+}
+
+
+const TFunction& TExprContext::copy(const TFunction& f)
+{
+    // Copies of the nodes, so a shared operand is copied once.
+    std::unordered_map<const TFunction*, const TFunction*> node_copy;
+
+    // Post-order traversal with an explicit stack as in TTape.
+    std::vector<std::pair<const TFunction*, bool>> stack = { { &f, false } };
+    while (not stack.empty()) {
+        auto [node, expanded] = stack.back();
+        stack.pop_back();
+
+        if (node_copy.count(node) != 0) {
+            continue;
+        }
+
+        const TFunction* res = node;
+
+        if (node->op_ != TFunction::Operation::None) {
+            if (not expanded) {
+                stack.push_back({ node, true });
+                stack.push_back({ node->rhs_, false });
+                stack.push_back({ node->lhs_, false });
+                continue;
+            }
+
+            res = &create(node->op_,
+                          *node_copy.at(node->lhs_),
+                          *node_copy.at(node->rhs_));
+
+        } else if (auto c_v = getBasicCoeffs(*node)) {
+            res = &basic(*c_v);
+        }
+
+        node_copy[node] = res;
+    }
+
+    return *node_copy.at(&f);
+}
@@ -0,0 +1,102 @@
+#ifndef ARENA_HEADER
+#define ARENA_HEADER
+
+
+#include "functions.hpp"
+
+#include <memory_resource>
+#include <map>
+
+
+// Node of the expression graph allocated in TExprContext. A leaf is a basic
+// function, an inner node applies op_ to lhs_ and rhs_. The functors capture
+// only this, so they fit into the small buffer of std::function and building
+// an inner node does not allocate memory on the heap.
+class TExprNode : public IPolynomial
+{
+public:
+    // Leaf with the coefficient vector of IPolynomial.
+    explicit TExprNode(const VectOfDouble& coeff_vect);
+
+    // Inner node of the operation.
+    TExprNode(Operation op, const TFunction& lhs, const TFunction& rhs);
+
+    // The functors point to the node itself.
+    TExprNode(const TExprNode&) = delete;
+    TExprNode& operator=(const TExprNode&) = delete;
+
+private:
+    friend class TExprContext;
+
+    // Next node allocated by the same context.
+    TExprNode* next_ = nullptr;
+};
+
+
+// Expression builder which owns its nodes. Nodes are allocated in a
+// monotonic arena and destroyed together with the context, so an operand can
+// not die before the nodes using it. The arena takes memory from the heap in
+// large chunks: if nodes_num covers the expression, the whole graph costs
+// one allocation. Leaves are shared by equal coefficient vectors and keep
+// their coefficients on the heap.
+//
+// Example:
+//     TExprContext ctx;
+//     const auto& x = ctx.ident();
+//     const auto& f = ctx.add(ctx.mul(x, ctx.exp()), ctx.constant(3));
+//     double y = f(1.5);
+class TExprContext
+{
+public:
+    explicit TExprContext(std::size_t nodes_num = 1024);
+    ~TExprContext();
+
+    TExprContext(const TExprContext&) = delete;
+    TExprContext& operator=(const TExprContext&) = delete;
+
+    // Methods to get the leaves.
+    const IPolynomial& ident();
+    const IPolynomial& constant(double c);
+    const IPolynomial& power(int n);
+    const IPolynomial& exp();
+    const IPolynomial& polynomial(const VectOfDouble& coeffs);
+
+    // Method to get the leaf with the coefficient vector of IPolynomial.
+    const IPolynomial& basic(const VectOfDouble& coeff_vect);
+
+    // Methods to build the operations. The operands are nodes of this
+    // context or functions which outlive it.
+    const IPolynomial& add(const TFunction& lhs, const TFunction& rhs);
+    const IPolynomial& sub(const TFunction& lhs, const TFunction& rhs);
+    const IPolynomial& mul(const TFunction& lhs, const TFunction& rhs);
+    const IPolynomial& div(const TFunction& lhs, const TFunction& rhs);
+    const IPolynomial& binary(TFunction::Operation op,
+                              const TFunction& lhs,
+                              const TFunction& rhs);
+
+    // Method to copy the function into the context. Composite functions are
+    // copied node by node, so the copy does not depend on their operands.
+    // Functions which are neither basic nor composite are referenced and
+    // must outlive the context.
+    const TFunction& copy(const TFunction& f);
+
+    std::size_t getNodesNum() const
+    {
+        return nodes_num_;
+    }
+
+private:
+    std::pmr::monotonic_buffer_resource arena_;
+    TExprNode* nodes_ = nullptr;
+    std::size_t nodes_num_ = 0;
+
+    // Leaves by their coefficient vectors.
+    std::map<VectOfDouble, const TExprNode*> leaves_;
+
+    // Method to allocate the node in the arena.
+    template<class... TArgs>
+    TExprNode& create(TArgs&&... args);
+};
+
+
+#endif
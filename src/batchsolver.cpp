@@ -0,0 +1,194 @@
+#include "batchsolver.hpp"
+
+#include <algorithm>
+#include <mutex>
+
+
+// Maximum number of halvings of the continuation step before the fold is
+// reported.
+#define CONT_MAX_HALVINGS 20
+
+
+TMultiStartResult MultiStartSolver::solveEquation(const IPolynomial& f,
+                                                  double a,
+                                                  double b,
+                                                  bool all_roots)
+{
+    TMultiStartResult res;
+    std::atomic<bool> stop_flag(false);
+    std::mutex mutex;
+
+    for (auto& s : solvers_) {
+        s.solver.setStopFlag(all_roots ? nullptr : &stop_flag);
+    }
+
+    pool_.parallelFor(starts_num_,
+    [&](std::size_t i, unsigned worker)
+    {
+        if (stop_flag.load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        // Centers of starts_num_ equal parts of [a, b].
+        double init_x = a + (b - a) * (i + 0.5) / starts_num_;
+        auto root = solvers_[worker].solver.solveEquation(f, init_x);
+        if (not root.has_value()) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (not res.root.has_value()) {
+            res.root = root;
+            stop_flag.store(not all_roots, std::memory_order_relaxed);
+        }
+
+        if (all_roots) {
+            res.roots.push_back(root.value());
+        }
+    });
+
+    for (auto& s : solvers_) {
+        s.solver.setStopFlag(nullptr);
+    }
+
+    // Merge the roots found from different starts.
+    std::sort(res.roots.begin(), res.roots.end());
+
+    std::vector<double> distinct;
+    for (double root : res.roots) {
+        if (distinct.empty() or root - distinct.back() > merge_tol_) {
+            distinct.push_back(root);
+        }
+    }
+
+    res.roots = std::move(distinct);
+
+    return res;
+}
+
+
+std::vector<TSweepPoint> ContinuationSolver::solveSweep(
+        const IPolynomial& f,
+        const IPolynomial& g,
+        const std::vector<double>& params)
+{
+    std::vector<TSweepPoint> res(params.size());
+    std::size_t chunks_num = (params.size() + chunk_size_ - 1) / chunk_size_;
+
+    pool_.parallelFor(chunks_num,
+    [&](std::size_t chunk, unsigned worker)
+    {
+        std::size_t begin = chunk * chunk_size_;
+        std::size_t end = std::min(params.size(), begin + chunk_size_);
+
+        sweepChunk(f,
+                   g,
+                   params.data() + begin,
+                   end - begin,
+                   res.data() + begin,
+                   solvers_[worker].solver);
+    });
+
+    return res;
+}
+
+void ContinuationSolver::sweepChunk(const IPolynomial& f,
+                                    const IPolynomial& g,
+                                    const double* params,
+                                    std::size_t n,
+                                    TSweepPoint* points,
+                                    EqSolver& solver) const
+{
+    // The function of the equation, p is changed between the solves.
+    double p = 0;
+    IPolynomial h(
+    [&](double x)
+    {
+        return f(x) + p * g(x);
+    },
+    [&](double x)
+    {
+        return f.getDeriv(x) + p * g.getDeriv(x);
+    },
+    [&](double x)
+    {
+        return f.getValDeriv(x) + TDual(p) * g.getValDeriv(x);
+    });
+
+    // The last point of the branch and the derivative of h there.
+    bool on_branch = false;
+    bool has_root = false;
+    double x = 0;
+    double branch_p = 0;
+    double h_deriv = 0;
+
+    for (std::size_t i = 0; i < n; i++) {
+        TSweepPoint& point = points[i];
+        double next_p = params[i];
+
+        if (on_branch) {
+            double step = next_p - branch_p;
+            unsigned halvings = 0;
+
+            while (branch_p != next_p and halvings <= CONT_MAX_HALVINGS) {
+                double step_p = std::abs(step) < std::abs(next_p - branch_p)
+                                ? branch_p + step
+                                : next_p;
+
+                // Tangent predictor.
+                double x_pred = x - g(x) / h_deriv * (step_p - branch_p);
+
+                p = step_p;
+                auto res = solver.solveWithStats(h, x_pred);
+                point.iters_num += res.iters_num;
+
+                bool accepted = false;
+                if (res.root.has_value()) {
+                    double root = res.root.value();
+                    double deriv = h.getDeriv(root);
+
+                    accepted = (deriv > 0) == (h_deriv > 0) and
+                               deriv != 0 and
+                               std::abs(root - x_pred) <=
+                                       std::max(0.5 * std::abs(x_pred - x),
+                                                tol_);
+
+                    if (accepted) {
+                        x = root;
+                        branch_p = step_p;
+                        h_deriv = deriv;
+                    }
+                }
+
+                if (not accepted) {
+                    step /= 2;
+                    halvings++;
+                }
+            }
+
+            if (branch_p == next_p) {
+                point.root = x;
+                continue;
+            }
+
+            point.fold = true;
+        }
+
+        // Cold start from the last root or from the initial point of the
+        // solver.
+        p = next_p;
+        auto res = has_root ? solver.solveWithStats(h, x)
+                            : solver.solveWithStats(h);
+        point.iters_num += res.iters_num;
+        point.root = res.root;
+
+        on_branch = false;
+        if (res.root.has_value()) {
+            x = res.root.value();
+            branch_p = next_p;
+            h_deriv = h.getDeriv(x);
+            has_root = true;
+            on_branch = h_deriv != 0 and std::isfinite(h_deriv);
+        }
+    }
+}
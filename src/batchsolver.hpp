@@ -0,0 +1,241 @@
+#ifndef BATCHSOLVER_HEADER
+#define BATCHSOLVER_HEADER
+
+
+#include "eqsolution.hpp"
+#include "threadpool.hpp"
+
+#include <vector>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+
+
+// Function to get the copy of the solver for a worker of the thread pool.
+// The copy does not record the trajectory, since the recorder is not safe for
+// concurrent solves. The cache is shared, it is safe for them.
+inline EqSolver getWorkerSolver(const EqSolver& solver)
+{
+    EqSolver res = solver;
+    res.setTrajectory(nullptr);
+
+    return res;
+}
+
+
+// Class to solve many independent equations in parallel. Every worker of
+// the thread pool has its own copy of the solver made by getWorkerSolver(),
+// so the state of one solve is not shared between threads. The equations are
+// balanced between the workers by work stealing, because the numbers of
+// iterations differ a lot.
+class BatchSolver
+{
+public:
+    BatchSolver(const EqSolver& solver = EqSolver(),
+                unsigned threads_num = TThreadPool::getDefaultThreadsNum())
+
+        : pool_ { threads_num },
+          solvers_(pool_.getThreadsNum(),
+                   TAlignedSolver { getWorkerSolver(solver) })
+    {}
+
+    // Method to solve the equations given by the range [first, last) of
+    // functions, pointers to functions, e.g. the results of the factory and
+    // of the operators, or coefficient vectors of IPolynomial. roots must
+    // hold last - first elements, roots[i] gets the root of the i-th
+    // equation. Throws std::logic_error if a function is not IPolynomial.
+    // The functions must be safe to evaluate from several threads.
+    template<class TIter>
+    void solveEquations(TIter first,
+                        TIter last,
+                        std::optional<double>* roots,
+                        std::size_t grain = 1)
+    {
+        pool_.parallelFor(last - first,
+        [this, first, roots](std::size_t i, unsigned worker)
+        {
+            const IPolynomial& f = toPolynomial(first[i]);
+            roots[i] = solvers_[worker].solver.solveEquation(f);
+        },
+        grain);
+    }
+
+    unsigned getThreadsNum() const
+    {
+        return pool_.getThreadsNum();
+    }
+
+private:
+    // Solvers are on separate cache lines.
+    struct alignas(64) TAlignedSolver
+    {
+        EqSolver solver;
+    };
+
+    TThreadPool pool_;
+    std::vector<TAlignedSolver> solvers_;
+
+    // Functions to get the function of the equation.
+    static const IPolynomial& toPolynomial(const IPolynomial& f)
+    {
+        return f;
+    }
+
+    static const IPolynomial& toPolynomial(const TFunction& f)
+    {
+        auto p = dynamic_cast<const IPolynomial*>(&f);
+        if (p == nullptr) {
+            throw std::logic_error("Error: Function is not IPolynomial");
+        }
+
+        return *p;
+    }
+
+    static const IPolynomial& toPolynomial(const IPolynomial* f)
+    {
+        return *f;
+    }
+
+    static const IPolynomial& toPolynomial(const TFunction* f)
+    {
+        return toPolynomial(*f);
+    }
+
+    template<class T>
+    static const IPolynomial& toPolynomial(const std::unique_ptr<T>& f)
+    {
+        return toPolynomial(*f);
+    }
+
+    static IPolynomial toPolynomial(const VectOfDouble& coeff_vect)
+    {
+        return IPolynomial(coeff_vect);
+    }
+};
+
+
+
+// Result of the multi-start search.
+struct TMultiStartResult
+{
+    // Root found first.
+    std::optional<double> root;
+
+    // Distinct roots in the ascending order if they are requested.
+    std::vector<double> roots;
+};
+
+
+// Class to solve the equation from many initial points at once. The points
+// are spread evenly over the given interval and solved on the thread pool.
+// If one root is enough the first converged start stops all others.
+class MultiStartSolver
+{
+public:
+    // Roots closer than merge_tol are treated as one root.
+    MultiStartSolver(const EqSolver& solver = EqSolver(),
+                     unsigned starts_num = 64,
+                     double merge_tol = 0.001,
+                     unsigned threads_num = TThreadPool::getDefaultThreadsNum())
+
+        : pool_ { threads_num },
+          solvers_(pool_.getThreadsNum(),
+                   TAlignedSolver { getWorkerSolver(solver) }),
+          starts_num_ { std::max(1u, starts_num) },
+          merge_tol_ { merge_tol }
+    {}
+
+    // Method to solve the equation from the points of [a, b]. If all_roots
+    // is true all starts are solved and the result has every distinct root.
+    TMultiStartResult solveEquation(const IPolynomial& f,
+                                    double a,
+                                    double b,
+                                    bool all_roots = false);
+
+private:
+    struct alignas(64) TAlignedSolver
+    {
+        EqSolver solver;
+    };
+
+    TThreadPool pool_;
+    std::vector<TAlignedSolver> solvers_;
+    unsigned starts_num_;
+    double merge_tol_;
+};
+
+
+
+// Solution of the equation of the sweep for one value of the parameter.
+struct TSweepPoint
+{
+    std::optional<double> root;
+
+    // Number of iterations of the solver for the point.
+    unsigned iters_num = 0;
+
+    // The branch of the previous point can not be continued to this one,
+    // e.g. it turns back at a fold. The root is found by a cold start then
+    // and may belong to another branch.
+    bool fold = false;
+};
+
+
+// Class to solve the family of equations f(x) + p g(x) = 0 for the grid of
+// the parameter p, e.g. g = 1 changes the constant coefficient of f. The
+// root for the previous value of p is continued to the next one: the
+// predictor follows the tangent dx/dp = -g(x) / (f'(x) + p g'(x)) and the
+// solver corrects it. If the correction is too large or the sign of the
+// derivative changes, the step is halved. If halving does not help either,
+// the branch has a fold and the point is solved by a cold start. The grid
+// is split into chunks which are swept in parallel, and each chunk starts
+// cold. So the grid should be ordered along the branch.
+class ContinuationSolver
+{
+public:
+    // The correction of the predictor is accepted if it is less than a half
+    // of the predicted step or tol.
+    ContinuationSolver(
+            const EqSolver& solver = EqSolver(1000,
+                                              1,
+                                              0.001,
+                                              EqSolver::Method::Newton),
+            std::size_t chunk_size = 1024,
+            double tol = 0.001,
+            unsigned threads_num = TThreadPool::getDefaultThreadsNum())
+
+        : pool_ { threads_num },
+          solvers_(pool_.getThreadsNum(),
+                   TAlignedSolver { getWorkerSolver(solver) }),
+          chunk_size_ { std::max<std::size_t>(1, chunk_size) },
+          tol_ { tol }
+    {}
+
+    // Method to solve the equations for every value of params. The functions
+    // must be safe to evaluate from several threads.
+    std::vector<TSweepPoint> solveSweep(const IPolynomial& f,
+                                        const IPolynomial& g,
+                                        const std::vector<double>& params);
+
+private:
+    struct alignas(64) TAlignedSolver
+    {
+        EqSolver solver;
+    };
+
+    TThreadPool pool_;
+    std::vector<TAlignedSolver> solvers_;
+    std::size_t chunk_size_;
+    double tol_;
+
+    // Method to sweep params[0], ..., params[n - 1] by the solver.
+    void sweepChunk(const IPolynomial& f,
+                    const IPolynomial& g,
+                    const double* params,
+                    std::size_t n,
+                    TSweepPoint* points,
+                    EqSolver& solver) const;
+};
+
+
+#endif
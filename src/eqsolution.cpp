@@ -1,12 +1,52 @@
 #include "eqsolution.hpp"
 
 #include <cstdlib>
+#include <cfloat>
+
+
+// Maximum number of halvings of the Newton step before the steepest descent
+// step is taken.
+#define NEWTON_MAX_HALVINGS 60
+
+// Maximum number of the steps of the line search to find and shrink the
+// bracket.
+#define LINE_SEARCH_MAX_STEPS 100
+
+// Fraction of the decrease of the linear model required by the Armijo
+// condition.
+#define ARMIJO_C 0.0001
+
+
+// Function to compare the values of |f| where NaN is greater than any
+// number, so the line search moves away from the points out of the domain.
+static bool isLess(double lhs, double rhs)
+{
+    return lhs < rhs or (std::isnan(rhs) and not std::isnan(lhs));
+}
 
 
 std::optional<double> EqSolver::get_alpha(double x,
-                                          double a0,
-                                          double b0,
-                                          unsigned recur_depth)
+                                          double abs_val,
+                                          double deriv)
+{
+    switch (line_search_) {
+      case LineSearch::Ternary: {
+        return ternarySearch(x, deriv);
+      }
+      case LineSearch::Backtracking: {
+        return backtracking(x, abs_val, deriv);
+      }
+      default: {
+        return goldenSection(x, abs_val, deriv);
+      }
+    }
+}
+
+std::optional<double> EqSolver::ternarySearch(double x,
+                                              double deriv,
+                                              double a0,
+                                              double b0,
+                                              unsigned recur_depth)
 {
     // If the current recursion depth is zero return {} as the  impossibility
     // of finding the minimum point.
@@ -21,9 +61,9 @@ std::optional<double> EqSolver::get_alpha(double x,
 
     // The function to minimize for the steepest descent.
     auto g =
-    [this](double x, double alpha)
+    [this, deriv](double x, double alpha)
     {
-        return abs_fun_(x - alpha * abs_fun_.getDeriv(x));
+        return getAbsVal(x - alpha * deriv);
     };
     
     // While a_k and b_k are not close iterate.
@@ -33,15 +73,17 @@ std::optional<double> EqSolver::get_alpha(double x,
 
         double g_l_k = g(x, l_k);
         double g_m_k = g(x, m_k);
+        res_.line_search_iters_num++;
 
         // If at least one function value is too huge call the function
         // reccurently.
         if (std::isnan(g_l_k) or std::isnan(g_m_k)) {
+            res_.nan_restarts_num++;
             double length = std::abs(b0 - a0);
             double new_a0 = a0 + length / 4;
             double new_b0 = b0 - length / 4;
             
-            return get_alpha(x, new_a0, new_b0, recur_depth - 1);
+            return ternarySearch(x, deriv, new_a0, new_b0, recur_depth - 1);
         }
 
         if (g_l_k <= g_m_k) {
@@ -58,60 +100,622 @@ std::optional<double> EqSolver::get_alpha(double x,
     return x_min;
 }
 
+std::optional<double> EqSolver::goldenSection(double x,
+                                              double abs_val,
+                                              double deriv)
+{
+    // Ratio of the golden section, r^2 = 1 - r.
+    const double r = 0.5 * (std::sqrt(5.0) - 1);
+
+    auto g =
+    [this, x, deriv](double alpha)
+    {
+        double res = getAbsVal(x - alpha * deriv);
+        res_.line_search_iters_num++;
+        if (std::isnan(res)) {
+            res_.nan_restarts_num++;
+        }
+
+        return res;
+    };
+
+    // Step to the root of the linear model of f.
+    double alpha = abs_val / (deriv * deriv);
+    if (not (alpha > 0) or std::isinf(alpha)) {
+        return {};
+    }
+
+    double lo = 0;
+    double hi = alpha;
+    double x1;
+    double g1;
+    bool has_x1 = false;
+
+    double g_alpha = g(alpha);
+    if (isLess(g_alpha, abs_val)) {
+        // Expand the bracket while |f| decreases. The point inside the
+        // bracket [lo, hi] is the golden section point of it.
+        double mid = alpha;
+        double g_mid = g_alpha;
+
+        for (unsigned i = 0; i < LINE_SEARCH_MAX_STEPS; i++) {
+            hi = mid + (mid - lo) / r;
+            double g_hi = g(hi);
+            if (not isLess(g_hi, g_mid)) {
+                break;
+            }
+
+            lo = mid;
+            mid = hi;
+            g_mid = g_hi;
+        }
+
+        x1 = mid;
+        g1 = g_mid;
+        has_x1 = true;
+    }
 
-std::optional<double> EqSolver::gr_descent()
+    if (not has_x1) {
+        x1 = hi - r * (hi - lo);
+        g1 = g(x1);
+    }
+
+    double x2 = lo + r * (hi - lo);
+    double g2 = g(x2);
+
+    // Shrink the bracket until the step is found with the accuracy eps in x.
+    for (unsigned i = 0; i < LINE_SEARCH_MAX_STEPS; i++) {
+        if ((hi - lo) * std::abs(deriv) < eps_) {
+            break;
+        }
+
+        if (not isLess(g2, g1)) {
+            hi = x2;
+            x2 = x1;
+            g2 = g1;
+            x1 = hi - r * (hi - lo);
+            g1 = g(x1);
+
+        } else {
+            lo = x1;
+            x1 = x2;
+            g1 = g2;
+            x2 = lo + r * (hi - lo);
+            g2 = g(x2);
+        }
+    }
+
+    double res = isLess(g2, g1) ? x2 : x1;
+    if (not isLess(std::min(g1, g2), abs_val)) {
+        return {};
+    }
+
+    return res;
+}
+
+std::optional<double> EqSolver::backtracking(double x,
+                                             double abs_val,
+                                             double deriv)
 {
-    std::vector<double> x(max_iter_);
-    x.at(0) = init_x_;
+    double slope = deriv * deriv;
 
-    unsigned k;
-    for (k = 0; k <= max_iter_ - 2; k++) {
-        auto alpha = get_alpha(x.at(k));
-        if (not alpha.has_value()) {
+    // Step to the root of the linear model of f.
+    double alpha = abs_val / slope;
+    if (not (alpha > 0) or std::isinf(alpha)) {
+        return {};
+    }
+
+    for (unsigned i = 0; i < LINE_SEARCH_MAX_STEPS; i++) {
+        double g_alpha = getAbsVal(x - alpha * deriv);
+        res_.line_search_iters_num++;
+        if (std::isnan(g_alpha)) {
+            res_.nan_restarts_num++;
+        }
+
+        if (g_alpha <= abs_val - ARMIJO_C * alpha * slope) {
+            return alpha;
+        }
+
+        alpha /= 2;
+    }
+
+    return {};
+}
+
+
+std::optional<double> EqSolver::gr_descent(double init_x)
+{
+    // Only the current iterate is kept.
+    double x = init_x;
+
+    for (unsigned k = 0; k + 1 < max_iter_; k++) {
+        if (isStopped()) {
             return {};
         }
 
-        x[k + 1] = x.at(k) - alpha.value() * abs_fun_.getDeriv(x.at(k));
+        record(x);
+        res_.iters_num++;
+        TDual abs_f = getAbsValDeriv(x);
+        setResidual(x, abs_f.val);
 
         // Stop the iterations if function value is close to zero.
-        if (std::abs(abs_fun_(x.at(k))) < eps_) {
-            return x.at(k);
+        if (std::abs(abs_f.val) < eps_) {
+            return x;
+        }
+
+        auto alpha = get_alpha(x, abs_f.val, abs_f.deriv);
+        if (not alpha.has_value()) {
+            return {};
         }
+
+        x -= alpha.value() * abs_f.deriv;
     }
 
     return {};
 }
 
 
-std::optional<double> EqSolver::solveEquation(const IPolynomial& f)
+std::optional<double> EqSolver::newton(double init_x)
 {
-    f_ = f;
+    double x = init_x;
+    TDual f_x = getValDeriv(x);
+
+    // Points with the negative and the positive values of f after the first
+    // change of sign.
+    bool bracketed = false;
+    double neg_x = 0;
+    double pos_x = 0;
+
+    // Steps of the two last iterations to detect slow convergence.
+    double step = 1;
+    double prev_step = 1;
+
+    for (unsigned k = 0; k < max_iter_; k++) {
+        if (isStopped()) {
+            return {};
+        }
+
+        record(x);
+        res_.iters_num++;
+        setResidual(x, std::abs(f_x.val));
+
+        // Stop the iterations if function value is close to zero and the
+        // iterations have converged.
+        if (f_x.val == 0 or
+                (std::abs(f_x.val) < eps_ and std::abs(step) < eps_)) {
+            return x;
+        }
+
+        if (not std::isfinite(f_x.val)) {
+            return {};
+        }
+
+        double newton_step = f_x.val / f_x.deriv;
+        double new_x;
+        TDual f_new_x;
+
+        if (bracketed) {
+            double lo = std::min(neg_x, pos_x);
+            double hi = std::max(neg_x, pos_x);
+
+            // The bracket can not be split any more, so f changes the sign
+            // without a root, e.g. at a pole.
+            if (hi - lo <= 2 * DBL_EPSILON * std::max(std::abs(lo),
+                                                      std::abs(hi))) {
+                return {};
+            }
+
+            new_x = x - newton_step;
+
+            // Bisection if the Newton point is out of the bracket or the
+            // step is not less than a half of the step before the last one.
+            if (not (new_x > lo and new_x < hi) or
+                    std::abs(2 * newton_step) > std::abs(prev_step)) {
+
+                new_x = lo + (hi - lo) / 2;
+            }
+
+            f_new_x = getValDeriv(new_x);
 
-    // Redefine the functors to get the minimum point of the function
-    // |f(x)|. That is the root of equation of the form f(x) = 0.
-    TFunction::Functor new_get_val_ftor_ =
-    [this](double x)
-    {
-        if (f_(x) >= 0) {
-            return f_(x);
-        
         } else {
-            return -f_(x);
+            // If the derivative is zero the last step is repeated to leave
+            // the stationary point.
+            double cur_step = std::isfinite(newton_step) ? newton_step : step;
+
+            new_x = x - cur_step;
+            f_new_x = getValDeriv(new_x);
+
+            // Halve the step while it does not decrease |f|. A change of sign
+            // is accepted, it brackets the root.
+            for (unsigned i = 0; i < NEWTON_MAX_HALVINGS; i++) {
+                if (std::abs(f_new_x.val) < std::abs(f_x.val) or
+                        f_new_x.val * f_x.val < 0) {
+                    break;
+                }
+
+                cur_step /= 2;
+                new_x = x - cur_step;
+                f_new_x = getValDeriv(new_x);
+            }
+
+            // Steepest descent step if the Newton direction does not help.
+            if (not (std::abs(f_new_x.val) < std::abs(f_x.val) or
+                     f_new_x.val * f_x.val < 0)) {
+
+                // |f| is at the level of the rounding errors near the root.
+                if (std::abs(f_x.val) < eps_) {
+                    return x;
+                }
+
+                double abs_deriv = f_x.val >= 0 ? f_x.deriv : -f_x.deriv;
+                auto alpha = get_alpha(x, std::abs(f_x.val), abs_deriv);
+                if (alpha.has_value() and alpha.value() * abs_deriv != 0) {
+                    new_x = x - alpha.value() * abs_deriv;
+                    f_new_x = getValDeriv(new_x);
+
+                } else {
+                    // x is a local minimum of |f| up to the rounding errors
+                    // of the derivative, so the last step is repeated in
+                    // both directions to leave it as at a zero derivative.
+                    TDual f_fwd = getValDeriv(x - step);
+                    TDual f_back = getValDeriv(x + step);
+                    bool fwd = std::abs(f_fwd.val) <= std::abs(f_back.val);
+
+                    new_x = fwd ? x - step : x + step;
+                    f_new_x = fwd ? f_fwd : f_back;
+                    if (not (std::abs(f_new_x.val) < std::abs(f_x.val) or
+                             f_new_x.val * f_x.val < 0)) {
+                        return {};
+                    }
+                }
+            }
+
+            if (f_new_x.val * f_x.val < 0) {
+                bracketed = true;
+                neg_x = x;
+                pos_x = x;
+            }
         }
-    };
 
-    TFunction::Functor new_get_deriv_ftor_ =
-    [this](double x)
-    {
-        if (f_(x) >= 0) {
-            return f_.getDeriv(x);
-        
+        // The new point replaces the end of the bracket with the same sign.
+        if (bracketed) {
+            if (f_new_x.val < 0) {
+                neg_x = new_x;
+            } else {
+                pos_x = new_x;
+            }
+        }
+
+        prev_step = step;
+        step = x - new_x;
+        x = new_x;
+        f_x = f_new_x;
+    }
+
+    return {};
+}
+
+
+std::optional<double> EqSolver::brent(double a, double b)
+{
+    double f_a = getVal(a);
+    double f_b = getVal(b);
+
+    if (f_a == 0) {
+        setResidual(a, 0);
+        return a;
+    }
+
+    if (f_b == 0) {
+        setResidual(b, 0);
+        return b;
+    }
+
+    if ((f_a > 0) == (f_b > 0) or std::isnan(f_a) or std::isnan(f_b)) {
+        return {};
+    }
+
+    // b is the best point, [b, c] is the bracket, a is the previous b.
+    double c = b;
+    double f_c = f_b;
+    double d = b - a;
+    double e = d;
+
+    for (unsigned k = 0; k < max_iter_; k++) {
+        if (isStopped()) {
+            return {};
+        }
+
+        res_.iters_num++;
+
+        if ((f_b > 0) == (f_c > 0)) {
+            c = a;
+            f_c = f_a;
+            d = b - a;
+            e = d;
+        }
+
+        if (std::abs(f_c) < std::abs(f_b)) {
+            a = b;
+            b = c;
+            c = a;
+            f_a = f_b;
+            f_b = f_c;
+            f_c = f_a;
+        }
+
+        // b is the best point of the bracket.
+        record(b);
+        setResidual(b, std::abs(f_b));
+
+        double tol = 2 * DBL_EPSILON * std::abs(b) + 0.5 * eps_;
+        double m = 0.5 * (c - b);
+
+        if (std::abs(m) <= tol or f_b == 0) {
+            return b;
+        }
+
+        // Interpolation step if the previous steps were large enough and
+        // decreased |f|, bisection otherwise.
+        if (std::abs(e) >= tol and std::abs(f_a) > std::abs(f_b)) {
+            double p;
+            double q;
+            double s = f_b / f_a;
+
+            if (a == c) {
+                // Secant.
+                p = 2 * m * s;
+                q = 1 - s;
+
+            } else {
+                // Inverse quadratic interpolation.
+                double r = f_b / f_c;
+                q = f_a / f_c;
+                p = s * (2 * m * q * (q - r) - (b - a) * (r - 1));
+                q = (q - 1) * (r - 1) * (s - 1);
+            }
+
+            if (p > 0) {
+                q = -q;
+            } else {
+                p = -p;
+            }
+
+            // Accept the interpolation if it falls into the bracket and
+            // the step is less than a half of the step before the last one.
+            if (2 * p < std::min(3 * m * q - std::abs(tol * q),
+                                 std::abs(e * q))) {
+                e = d;
+                d = p / q;
+
+            } else {
+                d = m;
+                e = d;
+            }
+
         } else {
-            return -f_.getDeriv(x);
+            d = m;
+            e = d;
         }
-    };
 
-    abs_fun_ = IPolynomial(new_get_val_ftor_, new_get_deriv_ftor_);
+        a = b;
+        f_a = f_b;
+        b += std::abs(d) > tol ? d : std::copysign(tol, m);
+        f_b = getVal(b);
+    }
+
+    return {};
+}
+
+
+std::optional<double> EqSolver::solveEquation(const IPolynomial& f)
+{
+    return solveEquation(f, init_x_);
+}
+
+std::optional<double> EqSolver::solveEquation(const IPolynomial& f,
+                                              double init_x)
+{
+    return solveWithStats(f, init_x).root;
+}
+
+TSolveResult EqSolver::solveWithStats(const IPolynomial& f)
+{
+    return solveWithStats(f, init_x_);
+}
+
+TSolveResult EqSolver::solveWithStats(const IPolynomial& f, double init_x)
+{
+    startSolve(f);
+
+    auto key = getCacheKey(false, init_x, init_x);
+    if (not findCached(key)) {
+        if (method_ == Method::Newton) {
+            res_.root = newton(init_x);
+
+        } else {
+            res_.root = gr_descent(init_x);
+        }
+
+        storeCached(key);
+    }
+
+    return finishSolve();
+}
+
+std::future<TSolveResult> EqSolver::solveAsync(
+        const IPolynomial& f,
+        std::chrono::steady_clock::time_point deadline,
+        const std::atomic<bool>* cancel) const
+{
+    EqSolver solver = *this;
+    solver.setTrajectory(nullptr);
+    solver.setDeadline(deadline);
+    if (cancel != nullptr) {
+        solver.setStopFlag(cancel);
+    }
+
+    return std::async(std::launch::async,
+    [solver, &f]() mutable
+    {
+        return solver.solveWithStats(f);
+    });
+}
+
+std::optional<double> EqSolver::solveEquation(const IPolynomial& f,
+                                              double a,
+                                              double b)
+{
+    return solveBracketed(f, a, b).root;
+}
+
+TSolveResult EqSolver::solveBracketed(const IPolynomial& f, double a, double b)
+{
+    startSolve(f);
+
+    auto key = getCacheKey(true, a, b);
+    if (not findCached(key)) {
+        res_.root = brent(a, b);
+        storeCached(key);
+    }
+
+    return finishSolve();
+}
+
+
+void EqSolver::startSolve(const IPolynomial& f)
+{
+    f_ = &f;
+    res_ = TSolveResult();
+    stopped_ = false;
+    start_ = std::chrono::steady_clock::now();
+
+    if (memoization_) {
+        memo_.reset(&f);
+    }
+}
+
+std::optional<std::uint64_t> EqSolver::getCacheKey(bool bracketed,
+                                                   double x0,
+                                                   double x1) const
+{
+    if (cache_ == nullptr) {
+        return {};
+    }
+
+    auto key = getFunctionHash(*f_);
+    if (not key.has_value()) {
+        return {};
+    }
+
+    // Brent's method does not depend on the method of the iterations.
+    mixHash(*key, static_cast<std::uint64_t>(bracketed));
+    if (not bracketed) {
+        mixHash(*key, static_cast<std::uint64_t>(method_));
+        mixHash(*key, static_cast<std::uint64_t>(line_search_));
+    }
+
+    mixHash(*key, static_cast<std::uint64_t>(max_iter_));
+    mixHash(*key, eps_);
+    mixHash(*key, x0);
+    mixHash(*key, x1);
+
+    return key;
+}
+
+bool EqSolver::findCached(std::optional<std::uint64_t> key)
+{
+    if (not key.has_value()) {
+        return false;
+    }
+
+    auto entry = cache_->find(*key);
+    if (not entry.has_value()) {
+        return false;
+    }
+
+    // The same value at the root rules out the collisions of the keys.
+    double val = getVal(entry->root);
+    if (val != entry->val) {
+        return false;
+    }
 
-    return gr_descent();
+    res_.root = entry->root;
+    res_.cached = true;
+    setResidual(entry->root, std::abs(val));
+    record(entry->root);
+
+    return true;
+}
+
+void EqSolver::storeCached(std::optional<std::uint64_t> key)
+{
+    if (not key.has_value() or not res_.root.has_value() or stopped_) {
+        return;
+    }
+
+    // The value for the check is not a part of the solve, so it is not
+    // counted.
+    cache_->insert(*key, { *res_.root, (*f_)(*res_.root) });
+}
+
+TSolveResult EqSolver::finishSolve()
+{
+    std::chrono::duration<double> time = std::chrono::steady_clock::now() -
+                                         start_;
+    res_.time = time.count();
+    res_.stopped = stopped_;
+
+    if (memoization_) {
+        res_.evals_num = memo_.getEvalsNum();
+        res_.derivs_num = memo_.getDerivsNum();
+        res_.memo_hits_num = memo_.getHitsNum();
+    }
+
+#ifdef EQSOLVER_STATS
+    getCounters().add(res_);
+#endif
+
+    return res_;
+}
+
+
+TSolverCounters& EqSolver::getCounters()
+{
+    static TSolverCounters counters;
+
+    return counters;
+}
+
+
+void TSolverCounters::add(const TSolveResult& res)
+{
+    // The counters are independent, so the relaxed order is enough.
+    auto order = std::memory_order_relaxed;
+
+    solves_num.fetch_add(1, order);
+    failures_num.fetch_add(res.root.has_value() ? 0 : 1, order);
+    evals_num.fetch_add(res.evals_num, order);
+    derivs_num.fetch_add(res.derivs_num, order);
+    iters_num.fetch_add(res.iters_num, order);
+    line_search_iters_num.fetch_add(res.line_search_iters_num, order);
+    nan_restarts_num.fetch_add(res.nan_restarts_num, order);
+    cache_hits_num.fetch_add(res.cached ? 1 : 0, order);
+    memo_hits_num.fetch_add(res.memo_hits_num, order);
+}
+
+void TSolverCounters::reset()
+{
+    for (auto counter : { &solves_num,
+                          &failures_num,
+                          &evals_num,
+                          &derivs_num,
+                          &iters_num,
+                          &line_search_iters_num,
+                          &nan_restarts_num,
+                          &cache_hits_num,
+                          &memo_hits_num }) {
+
+        counter->store(0);
+    }
 }
@@ -3,42 +3,386 @@
 
 
 #include "functions.hpp"
+#include "solvecache.hpp"
+#include "memo.hpp"
 
 #include <optional>
+#include <atomic>
+#include <algorithm>
+#include <cstddef>
+#include <cmath>
+#include <chrono>
+#include <future>
+
+
+// Result of the method which reports its cost.
+struct TSolveResult
+{
+    std::optional<double> root;
+    unsigned evals_num = 0;  // Number of evaluations of the function.
+    unsigned derivs_num = 0;  // Number of them with the derivative.
+    unsigned iters_num = 0;  // Number of iterations of the method.
+    unsigned line_search_iters_num = 0;  // Number of the line search steps.
+    unsigned nan_restarts_num = 0;  // Number of NaN values met by the search.
+    unsigned memo_hits_num = 0;  // Number of the evaluations taken from memo.
+    double residual = NAN;  // |f(x)| at the last iterate.
+    double time = 0;  // Wall time of the solve in seconds.
+
+    // The iterate with the least |f(x)| and its residual. If the solve is
+    // stopped the root is empty, but the best iterate is still known.
+    double best_x = NAN;
+    double best_residual = NAN;
+    bool stopped = false;  // The solve was stopped by the flag or deadline.
+    bool cached = false;  // The root was taken from the cache.
+};
+
+
+// Counters of the work of all solves of all solvers, e.g. to tune the
+// solver on a batch. They are updated once per solve only if the code is
+// compiled with EQSOLVER_STATS defined, otherwise they cost nothing and stay
+// zero.
+struct TSolverCounters
+{
+    std::atomic<unsigned long long> solves_num { 0 };
+    std::atomic<unsigned long long> failures_num { 0 };
+    std::atomic<unsigned long long> evals_num { 0 };
+    std::atomic<unsigned long long> derivs_num { 0 };
+    std::atomic<unsigned long long> iters_num { 0 };
+    std::atomic<unsigned long long> line_search_iters_num { 0 };
+    std::atomic<unsigned long long> nan_restarts_num { 0 };
+    std::atomic<unsigned long long> cache_hits_num { 0 };
+    std::atomic<unsigned long long> memo_hits_num { 0 };
+
+    void add(const TSolveResult& res);
+    void reset();
+};
+
+
+// Recorder of the iterates of the solver into the ring buffer given by the
+// caller. The buffer keeps the last capacity iterates, so recording never
+// allocates memory however many iterations are made.
+class TTrajectory
+{
+public:
+    TTrajectory(double* buffer, std::size_t capacity)
+        : buffer_ { buffer },
+          capacity_ { capacity }
+    {}
+
+    void push(double x)
+    {
+        if (capacity_ != 0) {
+            buffer_[total_num_ % capacity_] = x;
+        }
+
+        total_num_++;
+    }
+
+    void clear()
+    {
+        total_num_ = 0;
+    }
+
+    // Number of the kept iterates.
+    std::size_t getSize() const
+    {
+        return std::min(total_num_, capacity_);
+    }
+
+    // Number of the recorded iterates including the overwritten ones.
+    std::size_t getTotalNum() const
+    {
+        return total_num_;
+    }
+
+    // The i-th of the kept iterates from the oldest one.
+    double operator[](std::size_t i) const
+    {
+        return buffer_[(total_num_ - getSize() + i) % capacity_];
+    }
+
+private:
+    double* buffer_;
+    std::size_t capacity_;
+    std::size_t total_num_ = 0;
+};
 
 
 // Class to solve equations fo the form f(x) = 0.
 class EqSolver
 {
 public:
+    // Methods of the iterations.
+    enum class Method
+    {
+        // Steepest descent for |f(x)| with the line search.
+        GradientDescent,
+
+        // Newton-Raphson iterations. Until the root is bracketed by a change
+        // of sign the step is halved while it does not decrease |f(x)|, and
+        // the steepest descent step is taken if halving does not help. Inside
+        // the bracket the step falls back to bisection when it leaves the
+        // bracket or does not converge fast enough. The iterations stop when
+        // both |f(x)| and the last step are less than eps.
+        Newton
+    };
+
+    // Methods of the line search for the steepest descent steps. The step
+    // x - alpha * d along the derivative d of |f(x)| is searched for.
+    enum class LineSearch
+    {
+        // Ternary search of the minimum of |f| for alpha on the fixed
+        // interval [-10000, 10000] with two evaluations per step. It is the
+        // default.
+        Ternary,
+
+        // Golden-section search of the minimum of |f| which reuses one
+        // interior point, so it costs one evaluation per step. The initial
+        // bracket starts at the step to the root of the linear model of f
+        // and is expanded while |f| decreases.
+        GoldenSection,
+
+        // Backtracking from the step to the root of the linear model of f
+        // until the Armijo condition of sufficient decrease holds. Near the
+        // root the first step is accepted, so it costs one evaluation.
+        Backtracking
+    };
+
     EqSolver(unsigned max_iter = 1000,
              int init_x = 1,
-             double eps = 0.001)
+             double eps = 0.001,
+             Method method = Method::GradientDescent)
         
         : max_iter_ { max_iter },
           init_x_ { init_x },
-          eps_ { eps }
+          eps_ { eps },
+          method_ { method }
     {}
 
     // Method to solve the equation.
     std::optional<double> solveEquation(const IPolynomial& f);
 
+    // Method to solve the equation from the initial point init_x instead of
+    // the one given to the constructor.
+    std::optional<double> solveEquation(const IPolynomial& f, double init_x);
+
+    // Methods to solve the equation and get the statistics of the solve.
+    TSolveResult solveWithStats(const IPolynomial& f);
+    TSolveResult solveWithStats(const IPolynomial& f, double init_x);
+
+    // Method to solve the equation by a copy of the solver in another
+    // thread. The iterations stop at the deadline or when *cancel becomes
+    // true, then the result has no root but has the best iterate. f and
+    // cancel are taken by reference, so they must outlive the future. The
+    // copy does not record the trajectory, since the recorder is not safe
+    // for concurrent solves. The cache is shared, it is safe for them.
+    std::future<TSolveResult> solveAsync(
+            const IPolynomial& f,
+            std::chrono::steady_clock::time_point deadline =
+                    std::chrono::steady_clock::time_point::max(),
+            const std::atomic<bool>* cancel = nullptr) const;
+
+    // Method to solve the equation on [a, b] where f(a) and f(b) have
+    // different signs by Brent's method, which combines bisection, secant
+    // and inverse quadratic interpolation steps. The root is found with the
+    // accuracy eps in x and one evaluation of f per iteration. The root is
+    // empty if f does not change the sign on [a, b] or max_iter iterations
+    // are not enough.
+    std::optional<double> solveEquation(const IPolynomial& f,
+                                        double a,
+                                        double b);
+
+    // Method to solve the equation on [a, b] by Brent's method and get the
+    // statistics of the solve.
+    TSolveResult solveBracketed(const IPolynomial& f, double a, double b);
+
+    // Method to set the flag to stop the iterations of the solver from
+    // another thread. A stopped solve returns no root. The flag must outlive
+    // the solves, nullptr removes it.
+    void setStopFlag(const std::atomic<bool>* stop_flag)
+    {
+        stop_flag_ = stop_flag;
+    }
+
+    void setLineSearch(LineSearch line_search)
+    {
+        line_search_ = line_search;
+    }
+
+    // Method to set the time when the iterations of the next solves stop.
+    // A stopped solve returns no root.
+    void setDeadline(std::chrono::steady_clock::time_point deadline)
+    {
+        deadline_ = deadline;
+    }
+
+    // Method to set the recorder of the iterates of the next solves. The
+    // recorder must outlive the solves, nullptr removes it.
+    void setTrajectory(TTrajectory* trajectory)
+    {
+        trajectory_ = trajectory;
+    }
+
+    // Method to memoize the evaluations of f in the next solves, so the
+    // repeated queries at the same point do not evaluate f again. The point
+    // of the line search accepted as the next iterate needs only the
+    // derivative then. It pays for the expensive composite functions.
+    // evals_num and derivs_num count only the evaluations of f then.
+    void setMemoization(bool memoization)
+    {
+        memoization_ = memoization;
+    }
+
+    // Method to set the persistent cache of the roots consulted by the next
+    // solves. The key of the root is the hash of the function, the method,
+    // the settings and the initial point or the interval. A cached root is
+    // checked by one evaluation of f, and a root found by the solve is
+    // stored. The functions with parts which are not basic and not composite
+    // are not cached. The cache must outlive the solves, nullptr removes it.
+    void setCache(TSolveCache* cache)
+    {
+        cache_ = cache;
+    }
+
+    // Method to get the counters of all solves of all solvers.
+    static TSolverCounters& getCounters();
+
 private:
-    IPolynomial f_;
-    IPolynomial abs_fun_;
+    // The function of the current solve. It is not copied, so a solve does
+    // not allocate memory.
+    const IPolynomial* f_ = nullptr;
     unsigned max_iter_;
     int init_x_;
     double eps_;
+    Method method_;
+    LineSearch line_search_ = LineSearch::Ternary;
+    const std::atomic<bool>* stop_flag_ = nullptr;
+    std::chrono::steady_clock::time_point deadline_ =
+            std::chrono::steady_clock::time_point::max();
+    TTrajectory* trajectory_ = nullptr;
+    TSolveCache* cache_ = nullptr;
+    bool memoization_ = false;
+    TEvalMemo<> memo_;
+
+    // Statistics of the current solve.
+    TSolveResult res_;
+    std::chrono::steady_clock::time_point start_;
+    bool stopped_ = false;
+
+    // Method to check the stop flag and the deadline between the iterations.
+    // The clock is read only if the deadline is set.
+    bool isStopped()
+    {
+        stopped_ = (stop_flag_ != nullptr and
+                    stop_flag_->load(std::memory_order_relaxed)) or
+                   (deadline_ != std::chrono::steady_clock::time_point::max()
+                    and std::chrono::steady_clock::now() >= deadline_);
+
+        return stopped_;
+    }
+
+    // Method to set the residual of the iterate x.
+    void setResidual(double x, double residual)
+    {
+        res_.residual = residual;
+
+        if (std::isnan(res_.best_residual) or residual < res_.best_residual) {
+            res_.best_x = x;
+            res_.best_residual = residual;
+        }
+    }
+
+    void record(double x)
+    {
+        if (trajectory_ != nullptr) {
+            trajectory_->push(x);
+        }
+    }
+
+    // Methods to evaluate f counting the evaluations. The memo counts its
+    // evaluations itself.
+    double getVal(double x)
+    {
+        if (memoization_) {
+            return memo_.getVal(x);
+        }
 
-    // Method to get minimum point of the function on [a0, b0] for the
-    // steepest descent.
-    std::optional<double> get_alpha(double x,
-                                    double a0 = -10000,
-                                    double b0 =  10000,
-                                    unsigned recur_depth = 10);
+        res_.evals_num++;
+
+        return (*f_)(x);
+    }
+
+    TDual getValDeriv(double x)
+    {
+        if (memoization_) {
+            return memo_.getValDeriv(x);
+        }
+
+        res_.evals_num++;
+        res_.derivs_num++;
+
+        return f_->getValDeriv(x);
+    }
+
+    // Methods to get |f(x)|, the function minimized by the steepest descent.
+    // Its minimum points are the roots of the equation f(x) = 0.
+    double getAbsVal(double x)
+    {
+        return std::abs(getVal(x));
+    }
+
+    TDual getAbsValDeriv(double x)
+    {
+        TDual res = getValDeriv(x);
+
+        return res.val >= 0 ? res : -res;
+    }
+
+    // Methods to start the solve of f and to complete its statistics.
+    void startSolve(const IPolynomial& f);
+    TSolveResult finishSolve();
+
+    // Method to get the key of the solve of f_ in the cache, empty if there
+    // is no cache or f_ has no hash. x0 and x1 are the initial point or the
+    // interval of the method.
+    std::optional<std::uint64_t> getCacheKey(bool bracketed,
+                                             double x0,
+                                             double x1) const;
+
+    // Methods to take the root of the current solve from the cache if it is
+    // there and to store the found root into the cache.
+    bool findCached(std::optional<std::uint64_t> key);
+    void storeCached(std::optional<std::uint64_t> key);
+
+    // Method to get the step alpha of the steepest descent from x by the
+    // line search. abs_val and deriv are |f| and its derivative at x. The
+    // result is empty if the step is not found.
+    std::optional<double> get_alpha(double x, double abs_val, double deriv);
+
+    // Method to get minimum point of the function on [a0, b0] by the ternary
+    // search.
+    std::optional<double> ternarySearch(double x,
+                                        double deriv,
+                                        double a0 = -10000,
+                                        double b0 =  10000,
+                                        unsigned recur_depth = 10);
+
+    std::optional<double> goldenSection(double x,
+                                        double abs_val,
+                                        double deriv);
+
+    std::optional<double> backtracking(double x,
+                                       double abs_val,
+                                       double deriv);
 
     // Gradient descent algorithm.
-    std::optional<double> gr_descent();
+    std::optional<double> gr_descent(double init_x);
+
+    // Newton-Raphson algorithm with the safeguards.
+    std::optional<double> newton(double init_x);
+
+    // Brent's method on [a, b].
+    std::optional<double> brent(double a, double b);
 };
 
 
@@ -0,0 +1,357 @@
+#ifndef EXPR_HEADER
+#define EXPR_HEADER
+
+
+#include "functions.hpp"
+
+#include <memory>
+#include <type_traits>
+
+
+// Expression templates. Arithmetic operations with expressions build typed
+// expression objects, so the value and the derivative of the whole
+// expression are evaluated by inlined code without std::function calls.
+// Basic functions are turned into expressions by expr(), arithmetic on the
+// basic functions alone still gives std::unique_ptr<TFunction>.
+//
+// Example:
+//     auto e = expr(TIdent()) * TExp() + TConst(3);
+//     double y = e(1.5);
+//     std::unique_ptr<TFunction> f = e;
+
+
+// Tag base class to detect expression types.
+class TExprBase {};
+
+// Base class of expressions. Derived classes implement operator() and
+// getValDeriv(), which evaluates the expression on dual numbers.
+template<class TDerived>
+class TExpr : public TExprBase
+{
+public:
+    double getDeriv(double x) const
+    {
+        return self().getValDeriv(x).deriv;
+    }
+
+    // Method to get the type erased function. The expression is copied into
+    // the functors of the result, so it does not depend on this object.
+    std::unique_ptr<TFunction> toFunction() const
+    {
+        auto expr = std::make_shared<const TDerived>(self());
+
+        auto res = std::make_unique<IPolynomial>(
+        [expr](double x)
+        {
+            return (*expr)(x);
+        },
+        [expr](double x)
+        {
+            return expr->getDeriv(x);
+        },
+        [expr](double x)
+        {
+            return expr->getValDeriv(x);
+        });
+
+        res->get_val_batch_ftor_ =
+        [expr](const double* xs, double* out, std::size_t n)
+        {
+            for (std::size_t i = 0; i < n; i++) {
+                out[i] = (*expr)(xs[i]);
+            }
+        };
+
+        res->get_val_deriv_batch_ftor_ =
+        [expr](const double* xs,
+               double* val_out,
+               double* deriv_out,
+               std::size_t n)
+        {
+            for (std::size_t i = 0; i < n; i++) {
+                TDual res = expr->getValDeriv(xs[i]);
+                val_out[i] = res.val;
+                deriv_out[i] = res.deriv;
+            }
+        };
+
+        return res;
+    }
+
+    operator std::unique_ptr<TFunction>() const
+    {
+        return toFunction();
+    }
+
+private:
+    const TDerived& self() const
+    {
+        return static_cast<const TDerived&>(*this);
+    }
+};
+
+
+// Identical function.
+class TIdentExpr : public TExpr<TIdentExpr>
+{
+public:
+    double operator()(double x) const
+    {
+        return x;
+    }
+
+    TDual getValDeriv(double x) const
+    {
+        return TDual(x, 1);
+    }
+};
+
+// Constant function.
+class TConstExpr : public TExpr<TConstExpr>
+{
+public:
+    TConstExpr(double c)
+        : c_ { c }
+    {}
+
+    double operator()(double x) const
+    {
+        return c_;
+    }
+
+    TDual getValDeriv(double x) const
+    {
+        return TDual(c_, 0);
+    }
+
+private:
+    double c_;
+};
+
+// Exponential function.
+class TExpExpr : public TExpr<TExpExpr>
+{
+public:
+    double operator()(double x) const
+    {
+        return exp(x);
+    }
+
+    TDual getValDeriv(double x) const
+    {
+        return exp(TDual(x, 1));
+    }
+};
+
+// Function given by the coefficient vector of IPolynomial.
+class TPolyExpr : public TExpr<TPolyExpr>
+{
+public:
+    TPolyExpr(const VectOfDouble& coeff_vect)
+        : coeff_vect_ { coeff_vect }
+    {}
+
+    double operator()(double x) const
+    {
+        return polyVal(coeff_vect_, x);
+    }
+
+    TDual getValDeriv(double x) const
+    {
+        return polyValDeriv(coeff_vect_, x);
+    }
+
+private:
+    VectOfDouble coeff_vect_;
+};
+
+// Reference to the function which is not known at compile time. The function
+// must outlive the expression.
+class TRefExpr : public TExpr<TRefExpr>
+{
+public:
+    TRefExpr(const TFunction& f)
+        : f_ { f }
+    {}
+
+    double operator()(double x) const
+    {
+        return f_(x);
+    }
+
+    TDual getValDeriv(double x) const
+    {
+        return f_.getValDeriv(x);
+    }
+
+private:
+    const TFunction& f_;
+};
+
+// Function to use any function in the expression templates.
+inline TRefExpr ref(const TFunction& f)
+{
+    return TRefExpr(f);
+}
+
+
+// Binary operations. apply() is called both with the values and with the
+// dual numbers of the operands.
+struct TAddOp
+{
+    template<class T>
+    static T apply(const T& l, const T& r)
+    {
+        return l + r;
+    }
+};
+
+struct TSubOp
+{
+    template<class T>
+    static T apply(const T& l, const T& r)
+    {
+        return l - r;
+    }
+};
+
+struct TMulOp
+{
+    template<class T>
+    static T apply(const T& l, const T& r)
+    {
+        return l * r;
+    }
+};
+
+struct TDivOp
+{
+    template<class T>
+    static T apply(const T& l, const T& r)
+    {
+        return l / r;
+    }
+};
+
+// Expression of the binary operation. Operands are stored by value.
+template<class TOp, class TL, class TR>
+class TBinaryExpr : public TExpr<TBinaryExpr<TOp, TL, TR>>
+{
+public:
+    TBinaryExpr(const TL& lhs, const TR& rhs)
+        : lhs_ { lhs },
+          rhs_ { rhs }
+    {}
+
+    double operator()(double x) const
+    {
+        return TOp::apply(lhs_(x), rhs_(x));
+    }
+
+    TDual getValDeriv(double x) const
+    {
+        return TOp::apply(lhs_.getValDeriv(x), rhs_.getValDeriv(x));
+    }
+
+private:
+    TL lhs_;
+    TR rhs_;
+};
+
+
+// Functions to convert the operands to expressions.
+inline TIdentExpr toExpr(const TIdent& f)
+{
+    return TIdentExpr();
+}
+
+inline TConstExpr toExpr(const TConst& f)
+{
+    const auto& c_v = f.getCoeffVect();
+    return TConstExpr(c_v.size() > 1 ? c_v[1] : 0);
+}
+
+inline TExpExpr toExpr(const TExp& f)
+{
+    return TExpExpr();
+}
+
+inline TPolyExpr toExpr(const TPower& f)
+{
+    return TPolyExpr(f.getCoeffVect());
+}
+
+inline TPolyExpr toExpr(const TPolynomial& f)
+{
+    return TPolyExpr(f.getCoeffVect());
+}
+
+template<class T>
+std::enable_if_t<is_expr_v<T>, const T&> toExpr(const T& e)
+{
+    return e;
+}
+
+template<class T>
+using expr_t = std::decay_t<decltype(toExpr(std::declval<const T&>()))>;
+
+// Function to start the expression with the basic function.
+template<class T>
+expr_t<T> expr(const T& f)
+{
+    return toExpr(f);
+}
+
+
+// Types which are combined with the expressions.
+template<class T>
+constexpr bool is_expr_operand_v = std::is_same_v<T, TIdent> or
+                                   std::is_same_v<T, TConst> or
+                                   std::is_same_v<T, TPower> or
+                                   std::is_same_v<T, TExp> or
+                                   std::is_same_v<T, TPolynomial> or
+                                   is_expr_v<T>;
+
+// At least one of the operands is an expression.
+template<class TL, class TR>
+constexpr bool is_expr_op_v = is_expr_operand_v<TL> and
+                              is_expr_operand_v<TR> and
+                              (is_expr_v<TL> or is_expr_v<TR>);
+
+
+// Template functions to implement arithmetic operations with expressions.
+
+template<class TL, class TR>
+std::enable_if_t<is_expr_op_v<TL, TR>,
+        TBinaryExpr<TAddOp, expr_t<TL>, expr_t<TR>>>
+operator+(const TL& lhs, const TR& rhs)
+{
+    return { toExpr(lhs), toExpr(rhs) };
+}
+
+template<class TL, class TR>
+std::enable_if_t<is_expr_op_v<TL, TR>,
+        TBinaryExpr<TSubOp, expr_t<TL>, expr_t<TR>>>
+operator-(const TL& lhs, const TR& rhs)
+{
+    return { toExpr(lhs), toExpr(rhs) };
+}
+
+template<class TL, class TR>
+std::enable_if_t<is_expr_op_v<TL, TR>,
+        TBinaryExpr<TMulOp, expr_t<TL>, expr_t<TR>>>
+operator*(const TL& lhs, const TR& rhs)
+{
+    return { toExpr(lhs), toExpr(rhs) };
+}
+
+template<class TL, class TR>
+std::enable_if_t<is_expr_op_v<TL, TR>,
+        TBinaryExpr<TDivOp, expr_t<TL>, expr_t<TR>>>
+operator/(const TL& lhs, const TR& rhs)
+{
+    return { toExpr(lhs), toExpr(rhs) };
+}
+
+
+#endif
@@ -3,6 +3,10 @@
 #include <sstream>
 
 
+// Polynomials up to this size are multiplied by the schoolbook algorithm.
+#define KARATSUBA_THRESHOLD 32
+
+
 const std::string IPolynomial::toString() const
 {
     std::stringstream res;
@@ -73,6 +77,137 @@ double IPolynomial::getDeriv(double x) const
     return get_deriv_ftor_(x);
 }
 
+TDual IPolynomial::getValDeriv(double x) const
+{
+    return get_val_deriv_ftor_(x);
+}
+
+void IPolynomial::evaluate(const double* xs,
+                           double* out,
+                           std::size_t n) const
+{
+    get_val_batch_ftor_(xs, out, n);
+}
+
+void IPolynomial::evaluateDeriv(const double* xs,
+                                double* out,
+                                std::size_t n) const
+{
+    double val[BATCH_BLOCK_SIZE];
+
+    for (std::size_t b = 0; b < n; b += BATCH_BLOCK_SIZE) {
+        std::size_t m = std::min(BATCH_BLOCK_SIZE, n - b);
+        get_val_deriv_batch_ftor_(xs + b, val, out + b, m);
+    }
+}
+
+void IPolynomial::evaluateValDeriv(const double* xs,
+                                   double* val_out,
+                                   double* deriv_out,
+                                   std::size_t n) const
+{
+    get_val_deriv_batch_ftor_(xs, val_out, deriv_out, n);
+}
+
+
+void polyValBatch(const double* coeffs,
+                  std::size_t size,
+                  const double* xs,
+                  double* out,
+                  std::size_t n,
+                  bool fast_exp)
+{
+    // The loop over the coefficients is the outer one, so every step of the
+    // Horner scheme is one vectorized pass over the points.
+    for (std::size_t b = 0; b < n; b += BATCH_BLOCK_SIZE) {
+        std::size_t m = std::min(BATCH_BLOCK_SIZE, n - b);
+        const double* x = xs + b;
+        double* res = out + b;
+
+        #pragma omp simd
+        for (std::size_t j = 0; j < m; j++) {
+            res[j] = 0;
+        }
+
+        for (std::size_t i = size; i > 1; i--) {
+            double c = coeffs[i - 1];
+
+            #pragma omp simd
+            for (std::size_t j = 0; j < m; j++) {
+                res[j] = res[j] * x[j] + c;
+            }
+        }
+
+        if (size > 0 and coeffs[0] != 0) {
+            double c = coeffs[0];
+
+            if (fast_exp) {
+                #pragma omp simd
+                for (std::size_t j = 0; j < m; j++) {
+                    res[j] += c * fastExp(x[j]);
+                }
+
+            } else {
+                for (std::size_t j = 0; j < m; j++) {
+                    res[j] += c * exp(x[j]);
+                }
+            }
+        }
+    }
+}
+
+void polyValDerivBatch(const double* coeffs,
+                       std::size_t size,
+                       const double* xs,
+                       double* val_out,
+                       double* deriv_out,
+                       std::size_t n,
+                       bool fast_exp)
+{
+    for (std::size_t b = 0; b < n; b += BATCH_BLOCK_SIZE) {
+        std::size_t m = std::min(BATCH_BLOCK_SIZE, n - b);
+        const double* x = xs + b;
+        double* val = val_out + b;
+        double* deriv = deriv_out + b;
+
+        #pragma omp simd
+        for (std::size_t j = 0; j < m; j++) {
+            val[j] = 0;
+            deriv[j] = 0;
+        }
+
+        for (std::size_t i = size; i > 1; i--) {
+            double c = coeffs[i - 1];
+
+            #pragma omp simd
+            for (std::size_t j = 0; j < m; j++) {
+                deriv[j] = deriv[j] * x[j] + val[j];
+                val[j] = val[j] * x[j] + c;
+            }
+        }
+
+        if (size > 0 and coeffs[0] != 0) {
+            double c = coeffs[0];
+
+            if (fast_exp) {
+                #pragma omp simd
+                for (std::size_t j = 0; j < m; j++) {
+                    double exp_part = c * fastExp(x[j]);
+                    val[j] += exp_part;
+                    deriv[j] += exp_part;
+                }
+
+            } else {
+                for (std::size_t j = 0; j < m; j++) {
+                    double exp_part = c * exp(x[j]);
+                    val[j] += exp_part;
+                    deriv[j] += exp_part;
+                }
+            }
+        }
+    }
+}
+
 
 VectOfDouble vectAddition(const VectOfDouble& lhs, const VectOfDouble& rhs)
 {
@@ -104,3 +239,158 @@ VectOfDouble vectAddition(const VectOfDouble& lhs, const VectOfDouble& rhs)
     return res;
 }
 
+VectOfDouble vectSubtraction(const VectOfDouble& lhs, const VectOfDouble& rhs)
+{
+    VectOfDouble neg_rhs(rhs.size());
+    for (unsigned i = 0; i < rhs.size(); i++) {
+        neg_rhs[i] = -rhs[i];
+    }
+
+    return vectAddition(lhs, neg_rhs);
+}
+
+
+// Karatsuba multiplication of the polynomials a and b of the same size n.
+// res must hold 2n - 1 elements filled with zeros.
+static void karatsuba(const double* a,
+                      const double* b,
+                      std::size_t n,
+                      double* res)
+{
+    if (n <= KARATSUBA_THRESHOLD) {
+        for (std::size_t i = 0; i < n; i++) {
+            for (std::size_t j = 0; j < n; j++) {
+                res[i + j] += a[i] * b[j];
+            }
+        }
+
+        return;
+    }
+
+    // a = a0 + x^m * a1, b = b0 + x^m * b1, where a1 and b1 are not shorter
+    // than a0 and b0.
+    std::size_t m = n / 2;
+    std::size_t h = n - m;
+
+    VectOfDouble z0(2 * m - 1);
+    VectOfDouble z1(2 * h - 1);
+    VectOfDouble z2(2 * h - 1);
+    karatsuba(a, b, m, z0.data());
+    karatsuba(a + m, b + m, h, z2.data());
+
+    // z1 = (a0 + a1) * (b0 + b1) - z0 - z2.
+    VectOfDouble a_sum(a + m, a + n);
+    VectOfDouble b_sum(b + m, b + n);
+    for (std::size_t i = 0; i < m; i++) {
+        a_sum[i] += a[i];
+        b_sum[i] += b[i];
+    }
+
+    karatsuba(a_sum.data(), b_sum.data(), h, z1.data());
+
+    for (std::size_t i = 0; i < z0.size(); i++) {
+        z1[i] -= z0[i];
+        res[i] += z0[i];
+    }
+
+    for (std::size_t i = 0; i < z2.size(); i++) {
+        z1[i] -= z2[i];
+        res[i + 2 * m] += z2[i];
+    }
+
+    for (std::size_t i = 0; i < z1.size(); i++) {
+        res[i + m] += z1[i];
+    }
+}
+
+VectOfDouble polyMultiplication(const VectOfDouble& lhs,
+                                const VectOfDouble& rhs)
+{
+    if (lhs.empty() or rhs.empty()) {
+        return {};
+    }
+
+    // Small or very unbalanced polynomials are multiplied directly.
+    if (std::min(lhs.size(), rhs.size()) <= KARATSUBA_THRESHOLD) {
+        VectOfDouble res(lhs.size() + rhs.size() - 1);
+        for (std::size_t i = 0; i < lhs.size(); i++) {
+            for (std::size_t j = 0; j < rhs.size(); j++) {
+                res[i + j] += lhs[i] * rhs[j];
+            }
+        }
+
+        return res;
+    }
+
+    // Otherwise both polynomials are padded with zeros to the same size.
+    std::size_t n = std::max(lhs.size(), rhs.size());
+    VectOfDouble a(lhs);
+    VectOfDouble b(rhs);
+    a.resize(n);
+    b.resize(n);
+
+    VectOfDouble res(2 * n - 1);
+    karatsuba(a.data(), b.data(), n, res.data());
+    res.resize(lhs.size() + rhs.size() - 1);
+
+    return res;
+}
+
+std::optional<VectOfDouble> coeffMultiplication(const VectOfDouble& lhs,
+                                                const VectOfDouble& rhs)
+{
+    // Split the vectors into the exponent coefficient and the polynomial
+    // part: lhs = c0*exp(x) + P(x), rhs = d0*exp(x) + Q(x).
+    double c0 = lhs.empty() ? 0 : lhs[0];
+    double d0 = rhs.empty() ? 0 : rhs[0];
+    VectOfDouble p(lhs.begin() + std::min<std::size_t>(1, lhs.size()),
+                   lhs.end());
+    VectOfDouble q(rhs.begin() + std::min<std::size_t>(1, rhs.size()),
+                   rhs.end());
+
+    auto is_const =
+    [](const VectOfDouble& v)
+    {
+        for (std::size_t i = 1; i < v.size(); i++) {
+            if (v[i] != 0) {
+                return false;
+            }
+        }
+
+        return true;
+    };
+
+    // The product c0*d0*exp(2x) + (c0*Q + d0*P)*exp(x) + P*Q is a basic
+    // function only if exp(2x) vanishes and the polynomials multiplied by
+    // exp(x) are constants.
+    if ((c0 != 0 and d0 != 0) or
+            (c0 != 0 and not is_const(q)) or
+            (d0 != 0 and not is_const(p))) {
+        
+        return {};
+    }
+
+    double exp_coeff = 0;
+    if (c0 != 0 and not q.empty()) {
+        exp_coeff += c0 * q[0];
+    }
+
+    if (d0 != 0 and not p.empty()) {
+        exp_coeff += d0 * p[0];
+    }
+
+    VectOfDouble res = polyMultiplication(p, q);
+    res.insert(res.begin(), exp_coeff);
+
+    return res;
+}
+
+const VectOfDouble* getBasicCoeffs(const TFunction& f)
+{
+    auto poly = dynamic_cast<const IPolynomial*>(&f);
+    if (poly == nullptr or not poly->isBasic()) {
+        return nullptr;
+    }
+
+    return &poly->getCoeffVect();
+}
@@ -8,22 +8,111 @@
 #include <vector>
 #include <stdexcept>
 #include <functional>
+#include <utility>
+#include <algorithm>
+#include <optional>
 
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 
 
 using VectOfDouble = std::vector<double>;
 
 
+// Number of points processed at once by the batch evaluation. Composite
+// functions keep their temporary results for one block on the stack.
+constexpr std::size_t BATCH_BLOCK_SIZE = 256;
+
+
 // Function to add two vectors.
 VectOfDouble vectAddition(const VectOfDouble& lhs, const VectOfDouble& rhs);
 
+// Function to subtract two vectors.
+VectOfDouble vectSubtraction(const VectOfDouble& lhs, const VectOfDouble& rhs);
+
+// Function to multiply two polynomials given by the coefficients of
+// 1, x, x^2, ... Large polynomials are multiplied by Karatsuba algorithm.
+VectOfDouble polyMultiplication(const VectOfDouble& lhs,
+                                const VectOfDouble& rhs);
+
+// Function to multiply two coefficient vectors of IPolynomial. Returns {}
+// if the product has terms like x*exp(x) or exp(2x), which the coefficient
+// vector can not represent.
+std::optional<VectOfDouble> coeffMultiplication(const VectOfDouble& lhs,
+                                                const VectOfDouble& rhs);
+
+
+// Dual number to carry the value of the function and the value of its
+// derivative together through the arithmetic operations. Every
+// subexpression is evaluated once per point in this mode.
+struct TDual
+{
+    TDual(double v = 0, double d = 0)
+        : val { v },
+          deriv { d }
+    {}
+
+    double val;
+    double deriv;
+};
+
+inline TDual operator-(const TDual& d)
+{
+    return TDual(-d.val, -d.deriv);
+}
+
+inline TDual operator+(const TDual& lhs, const TDual& rhs)
+{
+    return TDual(lhs.val + rhs.val, lhs.deriv + rhs.deriv);
+}
+
+inline TDual operator-(const TDual& lhs, const TDual& rhs)
+{
+    return TDual(lhs.val - rhs.val, lhs.deriv - rhs.deriv);
+}
+
+inline TDual operator*(const TDual& lhs, const TDual& rhs)
+{
+    return TDual(lhs.val * rhs.val,
+                 lhs.deriv * rhs.val + lhs.val * rhs.deriv);
+}
+
+inline TDual operator/(const TDual& lhs, const TDual& rhs)
+{
+    return TDual(lhs.val / rhs.val,
+                 (lhs.deriv * rhs.val - lhs.val * rhs.deriv) /
+                 (rhs.val * rhs.val));
+}
+
+inline TDual exp(const TDual& d)
+{
+    double e = exp(d.val);
+    return TDual(e, e * d.deriv);
+}
+
 
 // Base abstract class.
 class TFunction
 {
 public:
     using Functor = std::function<double(double)>;
+
+    using ValDerivFunctor = std::function<TDual(double)>;
+
+    // Functors to evaluate the function on the array xs of n points. The
+    // output arrays must not overlap xs.
+    using BatchFunctor =
+            std::function<void(const double* xs, double* out, std::size_t n)>;
+    using BatchValDerivFunctor =
+            std::function<void(const double* xs,
+                               double* val_out,
+                               double* deriv_out,
+                               std::size_t n)>;
+    
+    // Operations of the composite functions.
+    enum class Operation { None, Add, Sub, Mul, Div };
     
     virtual ~TFunction() = default;
 
@@ -33,11 +122,169 @@ public:
     virtual double operator()(double x) const = 0;
     virtual double getDeriv(double x) const = 0;
 
+    // Method to get the value and the derivative value in one pass.
+    virtual TDual getValDeriv(double x) const = 0;
+
+    // Batch methods to get the values, the derivative values or both of them
+    // at every point of xs. Output arrays must hold n elements and must not
+    // overlap xs, since the composite functions write the values of the
+    // operands to them before the last points of xs are read.
+    virtual void evaluate(const double* xs,
+                          double* out,
+                          std::size_t n) const = 0;
+    virtual void evaluateDeriv(const double* xs,
+                               double* out,
+                               std::size_t n) const = 0;
+    virtual void evaluateValDeriv(const double* xs,
+                                  double* val_out,
+                                  double* deriv_out,
+                                  std::size_t n) const = 0;
+
     Functor get_val_ftor_;
     Functor get_deriv_ftor_;
+    ValDerivFunctor get_val_deriv_ftor_;
+    BatchFunctor get_val_batch_ftor_;
+    BatchValDerivFunctor get_val_deriv_batch_ftor_;
+
+    // Structure of the composite function built by the arithmetic
+    // operators. op_ is None for other functions. The operands are not owned.
+    Operation op_ = Operation::None;
+    const TFunction* lhs_ = nullptr;
+    const TFunction* rhs_ = nullptr;
 };
 
 
+// Exponent without the calls to libm, which is vectorized in the loops over
+// the points. x is reduced to x = k*ln(2) + r with |r| <= ln(2)/2, exp(r) is
+// the Taylor polynomial of degree 13 (truncation error below 1e-17) and
+// 2^k is built from the bits of the exponent. The result is within 1 ULP of
+// std::exp on the whole double range including subnormal results,
+// overflow to infinity, underflow to zero, infinities and NaN.
+inline double fastExp(double x)
+{
+    constexpr double log2e = 0x1.71547652b82fep0;
+    constexpr double ln2_hi = 0x1.62e42fee00000p-1;
+    constexpr double ln2_lo = 0x1.a39ef35793c76p-33;
+    constexpr double shifter = 0x1.8p52;
+
+    // Arguments out of [-746, 710] give 0 or infinity anyway. NaN is
+    // replaced here and restored at the end.
+    double xc = x > 710 ? 710 : x;
+    xc = xc < -746 ? -746 : xc;
+    xc = xc == xc ? xc : 0;
+
+    // k is rounded to the nearest integer by the addition of the shifter,
+    // the lower bits of t hold k. ln2_hi has few bits, so k*ln2_hi is exact.
+    double t = xc * log2e + shifter;
+    double k = t - shifter;
+    double r = xc - k * ln2_hi - k * ln2_lo;
+
+    double p = 1.0 / 6227020800;
+    p = p * r + 1.0 / 479001600;
+    p = p * r + 1.0 / 39916800;
+    p = p * r + 1.0 / 3628800;
+    p = p * r + 1.0 / 362880;
+    p = p * r + 1.0 / 40320;
+    p = p * r + 1.0 / 5040;
+    p = p * r + 1.0 / 720;
+    p = p * r + 1.0 / 120;
+    p = p * r + 1.0 / 24;
+    p = p * r + 1.0 / 6;
+    p = p * r + 0.5;
+    p = p * r + 1;
+    p = p * r + 1;
+
+    std::int64_t t_bits;
+    std::int64_t shifter_bits;
+    std::memcpy(&t_bits, &t, sizeof(t));
+    std::memcpy(&shifter_bits, &shifter, sizeof(shifter));
+
+    // 2^k is applied in two halves, so k < -1022 gives subnormal results
+    // with one rounding and k = 1024 gives the values close to DBL_MAX.
+    std::int64_t k_int = t_bits - shifter_bits;
+    std::int64_t k1 = ((k_int + 2048) >> 1) - 1024;
+    std::int64_t k2 = k_int - k1;
+    std::int64_t s1_bits = (k1 + 1023) << 52;
+    std::int64_t s2_bits = (k2 + 1023) << 52;
+
+    double s1;
+    double s2;
+    std::memcpy(&s1, &s1_bits, sizeof(s1));
+    std::memcpy(&s2, &s2_bits, sizeof(s2));
+
+    double res = p * s1 * s2;
+
+    return x == x ? res : x;
+}
+
+
+// Horner kernels for the coefficient vector of the form used by IPolynomial.
+// The exponent part is computed only if its coefficient is not zero.
+inline double polyVal(const double* coeffs, std::size_t size, double x)
+{
+    double res = 0;
+
+    // Horner scheme for c1 + c2*x + c3*x^2 + ...
+    for (std::size_t i = size; i > 1; i--) {
+        res = res * x + coeffs[i - 1];
+    }
+
+    if (size > 0 and coeffs[0] != 0) {
+        res += coeffs[0] * exp(x);
+    }
+
+    return res;
+}
+
+inline TDual polyValDeriv(const double* coeffs, std::size_t size, double x)
+{
+    double val = 0;
+    double deriv = 0;
+
+    // The derivative is accumulated from the intermediate values of the
+    // same Horner pass.
+    for (std::size_t i = size; i > 1; i--) {
+        deriv = deriv * x + val;
+        val = val * x + coeffs[i - 1];
+    }
+
+    // Both parts share one exp(x) call.
+    if (size > 0 and coeffs[0] != 0) {
+        double exp_part = coeffs[0] * exp(x);
+        val += exp_part;
+        deriv += exp_part;
+    }
+
+    return TDual(val, deriv);
+}
+
+inline double polyVal(const VectOfDouble& coeff_vect, double x)
+{
+    return polyVal(coeff_vect.data(), coeff_vect.size(), x);
+}
+
+inline TDual polyValDeriv(const VectOfDouble& coeff_vect, double x)
+{
+    return polyValDeriv(coeff_vect.data(), coeff_vect.size(), x);
+}
+
+// Batch Horner kernels. The loops over the points are vectorized. If
+// fast_exp is true the exponent is computed by fastExp(), which is
+// vectorized too, otherwise by libm.
+void polyValBatch(const double* coeffs,
+                  std::size_t size,
+                  const double* xs,
+                  double* out,
+                  std::size_t n,
+                  bool fast_exp = false);
+void polyValDerivBatch(const double* coeffs,
+                       std::size_t size,
+                       const double* xs,
+                       double* val_out,
+                       double* deriv_out,
+                       std::size_t n,
+                       bool fast_exp = false);
+
 
 // Intermediate class to represent polynomial nature of basic functions.
 class IPolynomial : public TFunction
@@ -45,21 +292,66 @@ class IPolynomial : public TFunction
 public:
     IPolynomial()
     {
-        get_val_ftor_ = basic_get_val_lambda_;
-        get_deriv_ftor_ = basic_get_deriv_lambda_;
+        bindBasicFunctors();
     }
 
     IPolynomial(const VectOfDouble c_v)
         : coeff_vect_ { c_v }
     {
-        get_val_ftor_ = basic_get_val_lambda_;
-        get_deriv_ftor_ = basic_get_deriv_lambda_;
+        bindBasicFunctors();
     }
 
     IPolynomial(const Functor& g_v, const Functor& g_d)
+        : is_basic_ { false }
     {
         get_val_ftor_ = g_v;
         get_deriv_ftor_ = g_d;
+        get_val_deriv_ftor_ =
+        [g_v, g_d](double x)
+        {
+            return TDual(g_v(x), g_d(x));
+        };
+
+        bindPointwiseBatchFunctors();
+    }
+
+    IPolynomial(const Functor& g_v,
+                const Functor& g_d,
+                const ValDerivFunctor& g_vd)
+        : is_basic_ { false }
+    {
+        get_val_ftor_ = g_v;
+        get_deriv_ftor_ = g_d;
+        get_val_deriv_ftor_ = g_vd;
+
+        bindPointwiseBatchFunctors();
+    }
+
+    // The basic functors capture this, so a copy of a basic function has to
+    // rebind them to itself instead of pointing to the source object.
+    IPolynomial(const IPolynomial& other)
+        : TFunction(other),
+          coeff_vect_ { other.coeff_vect_ },
+          is_basic_ { other.is_basic_ },
+          fast_exp_ { other.fast_exp_ }
+    {
+        if (is_basic_) {
+            bindBasicFunctors();
+        }
+    }
+
+    IPolynomial& operator=(const IPolynomial& other)
+    {
+        TFunction::operator=(other);
+        coeff_vect_ = other.coeff_vect_;
+        is_basic_ = other.is_basic_;
+        fast_exp_ = other.fast_exp_;
+
+        if (is_basic_) {
+            bindBasicFunctors();
+        }
+
+        return *this;
     }
     
     const VectOfDouble& getCoeffVect() const
@@ -67,10 +359,40 @@ public:
         return coeff_vect_;
     }
 
+    // True if the function is given by coeff_vect_ only.
+    bool isBasic() const
+    {
+        return is_basic_;
+    }
+
+    // Methods to select fastExp() instead of libm for the exponent part in
+    // the batch evaluation of the basic function. Composite functions use
+    // the modes of their basic operands.
+    void setFastExp(bool fast_exp)
+    {
+        fast_exp_ = fast_exp;
+    }
+
+    bool isFastExp() const
+    {
+        return fast_exp_;
+    }
+
     // Current class implement pure virtual functions in general terms.
     virtual const std::string toString() const override final;
     virtual double operator()(double x) const override final;
     virtual double getDeriv(double x) const override final;
+    virtual TDual getValDeriv(double x) const override final;
+    virtual void evaluate(const double* xs,
+                          double* out,
+                          std::size_t n) const override final;
+    virtual void evaluateDeriv(const double* xs,
+                               double* out,
+                               std::size_t n) const override final;
+    virtual void evaluateValDeriv(const double* xs,
+                                  double* val_out,
+                                  double* deriv_out,
+                                  std::size_t n) const override final;
 
 protected:
     // Coefficient vector of the polynom:
@@ -78,54 +400,90 @@ protected:
     // where c0, c1, ... are elements of coeff_vect_.
     VectOfDouble coeff_vect_;
 
+    // True if the functors evaluate coeff_vect_ directly.
+    bool is_basic_ = true;
+
+    // True if the batch functors use fastExp().
+    bool fast_exp_ = false;
+
+    void bindBasicFunctors()
+    {
+        is_basic_ = true;
+        get_val_ftor_ = basic_get_val_lambda_;
+        get_deriv_ftor_ = basic_get_deriv_lambda_;
+        get_val_deriv_ftor_ = basic_get_val_deriv_lambda_;
+
+        get_val_batch_ftor_ =
+        [this](const double* xs, double* out, std::size_t n)
+        {
+            polyValBatch(coeff_vect_.data(),
+                         coeff_vect_.size(),
+                         xs,
+                         out,
+                         n,
+                         fast_exp_);
+        };
+
+        get_val_deriv_batch_ftor_ =
+        [this](const double* xs,
+               double* val_out,
+               double* deriv_out,
+               std::size_t n)
+        {
+            polyValDerivBatch(coeff_vect_.data(),
+                              coeff_vect_.size(),
+                              xs,
+                              val_out,
+                              deriv_out,
+                              n,
+                              fast_exp_);
+        };
+    }
+
+    // Batch functors for functions given only by the scalar functors.
+    void bindPointwiseBatchFunctors()
+    {
+        get_val_batch_ftor_ =
+        [g_v = get_val_ftor_](const double* xs, double* out, std::size_t n)
+        {
+            for (std::size_t i = 0; i < n; i++) {
+                out[i] = g_v(xs[i]);
+            }
+        };
+
+        get_val_deriv_batch_ftor_ =
+        [g_vd = get_val_deriv_ftor_](const double* xs,
+                                     double* val_out,
+                                     double* deriv_out,
+                                     std::size_t n)
+        {
+            for (std::size_t i = 0; i < n; i++) {
+                TDual res = g_vd(xs[i]);
+                val_out[i] = res.val;
+                deriv_out[i] = res.deriv;
+            }
+        };
+    }
+
     // Get value lambda function for basic functions.
     Functor basic_get_val_lambda_ =
     [this](double x)
     {
-        double res = 0;
-
-        // Compute function value in for loop.
-        for (unsigned i = 0; i < this->getCoeffVect().size(); i++) {
-            switch (i) {
-              case 0: {
-                res += this->getCoeffVect()[i] * exp(x);
-                break;
-              }
-              case 1: {
-                res += this->getCoeffVect()[i];
-                break;
-              }
-              case 2: {
-                res += this->getCoeffVect()[i] * x;
-                break;
-              }
-              default: {
-                res += this->getCoeffVect()[i] * pow(x, i - 1);
-                break;
-              }
-            }
-        }
-
-        return res;
+        return polyVal(coeff_vect_, x);
     };
 
     // Get derivative lambda function for basic functions.
     Functor basic_get_deriv_lambda_ =
     [this](double x)
     {
-        double res = 0;
-
-        // Compute derivative value in for loop.
-        for (unsigned i = 0; i < coeff_vect_.size(); i++) {
-            if (i == 0) {
-                res += coeff_vect_[i] * exp(x);
-            
-            } else if (i > 1) {
-                    res += coeff_vect_[i] * (i - 1) * pow(x, i - 2);
-            }
-        }
+        return polyValDeriv(coeff_vect_, x).deriv;
+    };
 
-        return res;
+    // Get value and derivative lambda function for basic functions.
+    ValDerivFunctor basic_get_val_deriv_lambda_ =
+    [this](double x)
+    {
+        return polyValDeriv(coeff_vect_, x);
     };
 };
 
@@ -198,11 +556,194 @@ public:
 };
 
 
+// Function to evaluate the binary operation on the array of points. The
+// values of lhs are written right to the output, the values of rhs are kept
+// in a stack buffer of one block. out must not overlap xs.
+template<class TOp>
+void evaluateBinaryBatch(const TFunction& lhs,
+                         const TFunction& rhs,
+                         TOp op,
+                         const double* xs,
+                         double* out,
+                         std::size_t n)
+{
+    double r_val[BATCH_BLOCK_SIZE];
+
+    for (std::size_t b = 0; b < n; b += BATCH_BLOCK_SIZE) {
+        std::size_t m = std::min(BATCH_BLOCK_SIZE, n - b);
+        double* l_val = out + b;
+
+        lhs.get_val_batch_ftor_(xs + b, l_val, m);
+        rhs.get_val_batch_ftor_(xs + b, r_val, m);
+
+        #pragma omp simd
+        for (std::size_t i = 0; i < m; i++) {
+            l_val[i] = op(l_val[i], r_val[i]);
+        }
+    }
+}
+
+// Function to evaluate the value and the derivative of the binary operation
+// on the array of points. op is applied to the dual numbers of the operands.
+// The output arrays must not overlap xs.
+template<class TOp>
+void evaluateBinaryValDerivBatch(const TFunction& lhs,
+                                 const TFunction& rhs,
+                                 TOp op,
+                                 const double* xs,
+                                 double* val_out,
+                                 double* deriv_out,
+                                 std::size_t n)
+{
+    double r_val[BATCH_BLOCK_SIZE];
+    double r_deriv[BATCH_BLOCK_SIZE];
+
+    for (std::size_t b = 0; b < n; b += BATCH_BLOCK_SIZE) {
+        std::size_t m = std::min(BATCH_BLOCK_SIZE, n - b);
+        double* l_val = val_out + b;
+        double* l_deriv = deriv_out + b;
+
+        lhs.get_val_deriv_batch_ftor_(xs + b, l_val, l_deriv, m);
+        rhs.get_val_deriv_batch_ftor_(xs + b, r_val, r_deriv, m);
+
+        #pragma omp simd
+        for (std::size_t i = 0; i < m; i++) {
+            TDual res = op(TDual(l_val[i], l_deriv[i]),
+                           TDual(r_val[i], r_deriv[i]));
+            l_val[i] = res.val;
+            l_deriv[i] = res.deriv;
+        }
+    }
+}
+
+// Function to get the batch functor of the binary operation.
+template<class TOp>
+TFunction::BatchFunctor makeBatchFunctor(const TFunction& lhs,
+                                         const TFunction& rhs,
+                                         TOp op)
+{
+    return
+    [&lhs, &rhs, op](const double* xs, double* out, std::size_t n)
+    {
+        evaluateBinaryBatch(lhs, rhs, op, xs, out, n);
+    };
+}
+
+// Function to get the batch value and derivative functor of the binary
+// operation.
+template<class TOp>
+TFunction::BatchValDerivFunctor makeBatchValDerivFunctor(const TFunction& lhs,
+                                                         const TFunction& rhs,
+                                                         TOp op)
+{
+    return
+    [&lhs, &rhs, op](const double* xs,
+                     double* val_out,
+                     double* deriv_out,
+                     std::size_t n)
+    {
+        evaluateBinaryValDerivBatch(lhs, rhs, op, xs, val_out, deriv_out, n);
+    };
+}
+
+// Function to call f with the generic lambda of the operation, which is
+// known at run time only. None is treated as Add, it has no operands.
+template<class TF>
+decltype(auto) visitOperation(TFunction::Operation op, TF&& f)
+{
+    switch (op) {
+      case TFunction::Operation::Sub: {
+        return f([](const auto& l, const auto& r) { return l - r; });
+      }
+      case TFunction::Operation::Mul: {
+        return f([](const auto& l, const auto& r) { return l * r; });
+      }
+      case TFunction::Operation::Div: {
+        return f([](const auto& l, const auto& r) { return l / r; });
+      }
+      default: {
+        return f([](const auto& l, const auto& r) { return l + r; });
+      }
+    }
+}
+
+// Function to apply the operation to the values or the dual numbers.
+template<class T>
+T applyOperation(TFunction::Operation op, const T& lhs, const T& rhs)
+{
+    return visitOperation(op,
+    [&](auto f)
+    {
+        return T(f(lhs, rhs));
+    });
+}
+
+
+// Function to get the coefficient vector of the function if it is a basic
+// one. Returns nullptr for composite functions.
+const VectOfDouble* getBasicCoeffs(const TFunction& f);
+
+
+// Function to build the composite function of the binary operation. op is
+// a generic lambda applied both to the values and to the dual numbers of the
+// operands, op_kind records the operation in the result.
+template<class TOp>
+std::unique_ptr<TFunction> makeBinaryFunction(const TFunction& lhs,
+                                              const TFunction& rhs,
+                                              TFunction::Operation op_kind,
+                                              TOp op)
+{
+    TFunction::Functor new_get_val_ftor_ =
+    [&lhs, &rhs, op](double x)
+    {
+        return op(lhs.get_val_ftor_(x), rhs.get_val_ftor_(x));
+    };
+
+    TFunction::Functor new_get_deriv_ftor_ =
+    [&lhs, &rhs, op](double x)
+    {
+        return op(lhs.get_val_deriv_ftor_(x), rhs.get_val_deriv_ftor_(x)).deriv;
+    };
+
+    TFunction::ValDerivFunctor new_get_val_deriv_ftor_ =
+    [&lhs, &rhs, op](double x)
+    {
+        return op(lhs.get_val_deriv_ftor_(x), rhs.get_val_deriv_ftor_(x));
+    };
+
+    auto res = std::make_unique<IPolynomial>(new_get_val_ftor_,
+                                             new_get_deriv_ftor_,
+                                             new_get_val_deriv_ftor_);
+
+    // Composite functions are evaluated block by block in batch mode.
+    res->get_val_batch_ftor_ = makeBatchFunctor(lhs, rhs, op);
+    res->get_val_deriv_batch_ftor_ = makeBatchValDerivFunctor(lhs, rhs, op);
+
+    res->op_ = op_kind;
+    res->lhs_ = &lhs;
+    res->rhs_ = &rhs;
+
+    return res;
+}
+
+
+// Base class of the expression templates declared in expression.hpp.
+class TExprBase;
+
+// Expressions are combined by the operators of expression.hpp, which build
+// typed expressions instead of the closures below. Basic functions become
+// expressions only by expr(), so the operators below keep returning
+// std::unique_ptr<TFunction> for them.
+template<class T>
+constexpr bool is_expr_v = std::is_base_of_v<TExprBase, T>;
+
+
 // Template function to implement arithmetic operations with functions.
 
 template<class TL, class TR>
-std::enable_if_t<std::is_base_of_v<TFunction, TL> or
-                 std::is_base_of_v<TFunction, TR>,
+std::enable_if_t<(std::is_base_of_v<TFunction, TL> or
+                  std::is_base_of_v<TFunction, TR>) and
+                 not (is_expr_v<TL> or is_expr_v<TR>),
         std::unique_ptr<TFunction>>
 operator+(const TL& lhs, const TR& rhs)
 {
@@ -210,20 +751,19 @@ operator+(const TL& lhs, const TR& rhs)
     if constexpr (std::is_base_of_v<TFunction, TL> and
                   std::is_base_of_v<TFunction, TR>) {
         
-        TFunction::Functor new_get_val_ftor_ =
-        [&lhs, &rhs](double x)
-        {
-            return lhs.get_val_ftor_(x) + rhs.get_val_ftor_(x);
-        };
+        // Basic functions are added on the coefficient level.
+        auto l_coeffs = getBasicCoeffs(lhs);
+        auto r_coeffs = getBasicCoeffs(rhs);
+        if (l_coeffs and r_coeffs) {
+            return std::make_unique<IPolynomial>(vectAddition(*l_coeffs,
+                                                              *r_coeffs));
+        }
 
-        TFunction::Functor new_get_deriv_ftor_ =
-        [&lhs, &rhs](double x)
+        return makeBinaryFunction(lhs, rhs, TFunction::Operation::Add,
+        [](const auto& l, const auto& r)
         {
-            return lhs.get_deriv_ftor_(x) + rhs.get_deriv_ftor_(x);
-        };
-
-        return std::make_unique<IPolynomial>(new_get_val_ftor_,
-                                             new_get_deriv_ftor_);
+            return l + r;
+        });
 
     } else {
         throw std::logic_error("Error: Incompatible types");
@@ -231,8 +771,9 @@ operator+(const TL& lhs, const TR& rhs)
 }
 
 template<class TL, class TR>
-std::enable_if_t<std::is_base_of_v<TFunction, TL> or
-                 std::is_base_of_v<TFunction, TR>,
+std::enable_if_t<(std::is_base_of_v<TFunction, TL> or
+                  std::is_base_of_v<TFunction, TR>) and
+                 not (is_expr_v<TL> or is_expr_v<TR>),
         std::unique_ptr<TFunction>>
 operator-(const TL& lhs, const TR& rhs)
 {
@@ -240,20 +781,19 @@ operator-(const TL& lhs, const TR& rhs)
     if constexpr (std::is_base_of_v<TFunction, TL> and
                   std::is_base_of_v<TFunction, TR>) {
         
-        TFunction::Functor new_get_val_ftor_ =
-        [&lhs, &rhs](double x)
-        {
-            return lhs.get_val_ftor_(x) - rhs.get_val_ftor_(x);
-        };
+        // Basic functions are subtracted on the coefficient level.
+        auto l_coeffs = getBasicCoeffs(lhs);
+        auto r_coeffs = getBasicCoeffs(rhs);
+        if (l_coeffs and r_coeffs) {
+            return std::make_unique<IPolynomial>(vectSubtraction(*l_coeffs,
+                                                                 *r_coeffs));
+        }
 
-        TFunction::Functor new_get_deriv_ftor_ =
-        [&lhs, &rhs](double x)
+        return makeBinaryFunction(lhs, rhs, TFunction::Operation::Sub,
+        [](const auto& l, const auto& r)
         {
-            return lhs.get_deriv_ftor_(x) - rhs.get_deriv_ftor_(x);
-        };
-
-        return std::make_unique<IPolynomial>(new_get_val_ftor_,
-                                             new_get_deriv_ftor_);
+            return l - r;
+        });
 
     } else {
         throw std::logic_error("Error: Incompatible types");
@@ -261,8 +801,9 @@ operator-(const TL& lhs, const TR& rhs)
 }
 
 template<class TL, class TR>
-std::enable_if_t<std::is_base_of_v<TFunction, TL> or
-                 std::is_base_of_v<TFunction, TR>,
+std::enable_if_t<(std::is_base_of_v<TFunction, TL> or
+                  std::is_base_of_v<TFunction, TR>) and
+                 not (is_expr_v<TL> or is_expr_v<TR>),
         std::unique_ptr<TFunction>>
 operator*(const TL& lhs, const TR& rhs)
 {
@@ -270,21 +811,22 @@ operator*(const TL& lhs, const TR& rhs)
     if constexpr (std::is_base_of_v<TFunction, TL> and
                   std::is_base_of_v<TFunction, TR>) {
         
-        TFunction::Functor new_get_val_ftor_ =
-        [&lhs, &rhs](double x)
-        {
-            return lhs.get_val_ftor_(x) * rhs.get_val_ftor_(x);
-        };
+        // Basic functions are multiplied on the coefficient level if the
+        // product is a basic function too.
+        auto l_coeffs = getBasicCoeffs(lhs);
+        auto r_coeffs = getBasicCoeffs(rhs);
+        if (l_coeffs and r_coeffs) {
+            auto coeffs = coeffMultiplication(*l_coeffs, *r_coeffs);
+            if (coeffs.has_value()) {
+                return std::make_unique<IPolynomial>(coeffs.value());
+            }
+        }
 
-        TFunction::Functor new_get_deriv_ftor_ =
-        [&lhs, &rhs](double x)
+        return makeBinaryFunction(lhs, rhs, TFunction::Operation::Mul,
+        [](const auto& l, const auto& r)
         {
-            return lhs.get_deriv_ftor_(x) * rhs.get_val_ftor_(x) +
-                   lhs.get_val_ftor_(x) * rhs.get_deriv_ftor_(x);
-        };
-
-        return std::make_unique<IPolynomial>(new_get_val_ftor_,
-                                             new_get_deriv_ftor_);
+            return l * r;
+        });
 
     } else {
         throw std::logic_error("Error: Incompatible types");
@@ -292,8 +834,9 @@ operator*(const TL& lhs, const TR& rhs)
 }
 
 template<class TL, class TR>
-std::enable_if_t<std::is_base_of_v<TFunction, TL> or
-                 std::is_base_of_v<TFunction, TR>,
+std::enable_if_t<(std::is_base_of_v<TFunction, TL> or
+                  std::is_base_of_v<TFunction, TR>) and
+                 not (is_expr_v<TL> or is_expr_v<TR>),
         std::unique_ptr<TFunction>>
 operator/(const TL& lhs, const TR& rhs)
 {
@@ -301,22 +844,11 @@ operator/(const TL& lhs, const TR& rhs)
     if constexpr (std::is_base_of_v<TFunction, TL> and
                   std::is_base_of_v<TFunction, TR>) {
         
-        TFunction::Functor new_get_val_ftor_ =
-        [&lhs, &rhs](double x)
-        {
-            return lhs.get_val_ftor_(x) / rhs.get_val_ftor_(x);
-        };
-
-        TFunction::Functor new_get_deriv_ftor_ =
-        [&lhs, &rhs](double x)
+        return makeBinaryFunction(lhs, rhs, TFunction::Operation::Div,
+        [](const auto& l, const auto& r)
         {
-            return (lhs.get_deriv_ftor_(x) * rhs.get_val_ftor_(x) -
-                    lhs.get_val_ftor_(x) * rhs.get_deriv_ftor_(x)) /
-                   (rhs.get_val_ftor_(x) * rhs.get_val_ftor_(x));
-        };
-
-        return std::make_unique<IPolynomial>(new_get_val_ftor_,
-                                             new_get_deriv_ftor_);
+            return l / r;
+        });
 
     } else {
         throw std::logic_error("Error: Incompatible types");
@@ -0,0 +1,312 @@
+#include "interval.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+
+// Number of slots evaluated on the stack as in TTape.
+#define INTERVAL_STACK_SLOTS 64
+
+// Position of the split point of the box from its lower bound. The boxes
+// are split a bit off the midpoint, so a root at a simple point like 0 does
+// not fall on the common bound of two boxes.
+#define INTERVAL_SPLIT_RATIO 0.4921875
+
+
+// Functions to round the bound outwards.
+static double roundDown(double x)
+{
+    return std::nextafter(x, -HUGE_VAL);
+}
+
+static double roundUp(double x)
+{
+    return std::nextafter(x, HUGE_VAL);
+}
+
+static TInterval getEntire()
+{
+    return TInterval(-HUGE_VAL, HUGE_VAL);
+}
+
+// Function to get the interval with the bounds rounded outwards, the whole
+// line if a bound is NaN.
+static TInterval makeInterval(double lo, double hi)
+{
+    if (std::isnan(lo) or std::isnan(hi)) {
+        return getEntire();
+    }
+
+    return TInterval(roundDown(lo), roundUp(hi));
+}
+
+// Function to multiply the bounds, zero times infinity is zero.
+static double mulBounds(double lhs, double rhs)
+{
+    return (lhs == 0 or rhs == 0) ? 0 : lhs * rhs;
+}
+
+
+TInterval operator-(const TInterval& i)
+{
+    return TInterval(-i.hi, -i.lo);
+}
+
+TInterval operator+(const TInterval& lhs, const TInterval& rhs)
+{
+    return makeInterval(lhs.lo + rhs.lo, lhs.hi + rhs.hi);
+}
+
+TInterval operator-(const TInterval& lhs, const TInterval& rhs)
+{
+    return makeInterval(lhs.lo - rhs.hi, lhs.hi - rhs.lo);
+}
+
+TInterval operator*(const TInterval& lhs, const TInterval& rhs)
+{
+    double p[] = { mulBounds(lhs.lo, rhs.lo),
+                   mulBounds(lhs.lo, rhs.hi),
+                   mulBounds(lhs.hi, rhs.lo),
+                   mulBounds(lhs.hi, rhs.hi) };
+
+    return makeInterval(*std::min_element(p, p + 4),
+                        *std::max_element(p, p + 4));
+}
+
+TInterval operator/(const TInterval& lhs, const TInterval& rhs)
+{
+    if (rhs.contains(0)) {
+        return getEntire();
+    }
+
+    double q[] = { lhs.lo / rhs.lo,
+                   lhs.lo / rhs.hi,
+                   lhs.hi / rhs.lo,
+                   lhs.hi / rhs.hi };
+
+    for (double bound : q) {
+        if (std::isnan(bound)) {
+            return getEntire();
+        }
+    }
+
+    return makeInterval(*std::min_element(q, q + 4),
+                        *std::max_element(q, q + 4));
+}
+
+TInterval exp(const TInterval& i)
+{
+    // The error of std::exp is less than one unit in the last place.
+    TInterval res = makeInterval(std::exp(i.lo), std::exp(i.hi));
+    res.lo = std::max(0.0, res.lo);
+
+    return res;
+}
+
+std::optional<TInterval> intersect(const TInterval& lhs,
+                                   const TInterval& rhs)
+{
+    double lo = std::max(lhs.lo, rhs.lo);
+    double hi = std::min(lhs.hi, rhs.hi);
+    if (lo > hi) {
+        return {};
+    }
+
+    return TInterval(lo, hi);
+}
+
+
+TIntervalDual operator+(const TIntervalDual& lhs, const TIntervalDual& rhs)
+{
+    return TIntervalDual(lhs.val + rhs.val, lhs.deriv + rhs.deriv);
+}
+
+TIntervalDual operator-(const TIntervalDual& lhs, const TIntervalDual& rhs)
+{
+    return TIntervalDual(lhs.val - rhs.val, lhs.deriv - rhs.deriv);
+}
+
+TIntervalDual operator*(const TIntervalDual& lhs, const TIntervalDual& rhs)
+{
+    return TIntervalDual(lhs.val * rhs.val,
+                         lhs.deriv * rhs.val + lhs.val * rhs.deriv);
+}
+
+TIntervalDual operator/(const TIntervalDual& lhs, const TIntervalDual& rhs)
+{
+    // (f / g)' = (f' - (f / g) g') / g has fewer operations than the
+    // quotient rule.
+    TInterval val = lhs.val / rhs.val;
+
+    return TIntervalDual(val, (lhs.deriv - val * rhs.deriv) / rhs.val);
+}
+
+TIntervalDual exp(const TIntervalDual& d)
+{
+    TInterval e = exp(d.val);
+
+    return TIntervalDual(e, e * d.deriv);
+}
+
+
+TIntervalFunction::TIntervalFunction(const TFunction& f)
+    : tape_ { f }
+{
+    for (const auto& instr : tape_.getInstrs()) {
+        if (instr.code == TTape::TOpCode::Call) {
+            throw std::logic_error("Error: Function has no interval "
+                                   "extension");
+        }
+    }
+}
+
+template<class T>
+T TIntervalFunction::run(const T& x, T* slots) const
+{
+    const auto& coeffs = tape_.getCoeffs();
+
+    for (const auto& instr : tape_.getInstrs()) {
+        switch (instr.code) {
+          case TTape::TOpCode::Const: {
+            slots[instr.dst] = T(coeffs[instr.arg]);
+            break;
+          }
+          case TTape::TOpCode::Poly: {
+            // Horner scheme from the leading coefficient, so the constant
+            // coefficients are not widened by the multiplication by zero.
+            const double* c = &coeffs[instr.arg];
+            T v = instr.size > 1 ? T(c[instr.size - 1]) : T(0.0);
+
+            for (std::size_t i = instr.size - 1; i > 1; i--) {
+                v = v * x + T(c[i - 1]);
+            }
+
+            if (instr.size > 0 and c[0] != 0) {
+                v = v + T(c[0]) * exp(x);
+            }
+
+            slots[instr.dst] = v;
+            break;
+          }
+          case TTape::TOpCode::Add: {
+            slots[instr.dst] = slots[instr.lhs] + slots[instr.rhs];
+            break;
+          }
+          case TTape::TOpCode::Sub: {
+            slots[instr.dst] = slots[instr.lhs] - slots[instr.rhs];
+            break;
+          }
+          case TTape::TOpCode::Mul: {
+            slots[instr.dst] = slots[instr.lhs] * slots[instr.rhs];
+            break;
+          }
+          case TTape::TOpCode::Div: {
+            slots[instr.dst] = slots[instr.lhs] / slots[instr.rhs];
+            break;
+          }
+          default: {
+            break;
+          }
+        }
+    }
+
+    return slots[tape_.getResultSlot()];
+}
+
+template<class T>
+T TIntervalFunction::evaluate(const T& x) const
+{
+    if (tape_.getSlotsNum() <= INTERVAL_STACK_SLOTS) {
+        T slots[INTERVAL_STACK_SLOTS];
+        return run(x, slots);
+    }
+
+    std::vector<T> slots(tape_.getSlotsNum());
+    return run(x, slots.data());
+}
+
+TInterval TIntervalFunction::operator()(const TInterval& x) const
+{
+    return evaluate(x);
+}
+
+TIntervalDual TIntervalFunction::getValDeriv(const TInterval& x) const
+{
+    return evaluate(TIntervalDual(x, 1.0));
+}
+
+
+TIntervalSolveResult IntervalSolver::solveEquation(const TFunction& f,
+                                                   double a,
+                                                   double b) const
+{
+    if (not (a <= b) or not std::isfinite(a) or not std::isfinite(b)) {
+        throw std::logic_error("Error: Invalid interval");
+    }
+
+    TIntervalFunction f_ext(f);
+    TIntervalSolveResult res;
+
+    // Boxes to examine with the flag of the proven unique root. The lower
+    // box is examined first, so the roots are found in the ascending order.
+    std::vector<std::pair<TInterval, bool>> boxes = { { TInterval(a, b),
+                                                        false } };
+    unsigned boxes_num = 0;
+
+    while (not boxes.empty()) {
+        if (boxes_num == max_boxes_) {
+            res.complete = false;
+            break;
+        }
+
+        boxes_num++;
+        auto [x, unique] = boxes.back();
+        boxes.pop_back();
+
+        TIntervalDual f_x = f_ext.getValDeriv(x);
+        if (not f_x.val.contains(0)) {
+            continue;
+        }
+
+        // Newton step if f is monotone on the box.
+        bool shrunk = false;
+        bool stalled = false;
+
+        if (not f_x.deriv.contains(0)) {
+            double m = x.getMid();
+            TInterval n = TInterval(m) - f_ext(TInterval(m)) / f_x.deriv;
+
+            auto new_x = intersect(x, n);
+            if (not new_x.has_value()) {
+                continue;
+            }
+
+            unique = unique or n.isInterior(x);
+            shrunk = new_x->getWidth() <= 0.5 * x.getWidth();
+            stalled = new_x->getWidth() >= x.getWidth();
+            x = new_x.value();
+        }
+
+        // The root is enclosed tightly enough or up to the rounding errors.
+        if (x.getWidth() <= eps_ or (unique and stalled)) {
+            res.roots.push_back({ x, unique });
+            continue;
+        }
+
+        if (shrunk) {
+            boxes.push_back({ x, unique });
+            continue;
+        }
+
+        double split = x.lo + INTERVAL_SPLIT_RATIO * (x.hi - x.lo);
+        if (not (x.lo < split and split < x.hi)) {
+            res.roots.push_back({ x, unique });
+            continue;
+        }
+
+        boxes.push_back({ TInterval(split, x.hi), false });
+        boxes.push_back({ TInterval(x.lo, split), false });
+    }
+
+    return res;
+}
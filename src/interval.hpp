@@ -0,0 +1,171 @@
+#ifndef INTERVAL_HEADER
+#define INTERVAL_HEADER
+
+
+#include "functions.hpp"
+#include "tape.hpp"
+
+#include <vector>
+#include <optional>
+
+
+// Closed interval [lo, hi] of real numbers. The bounds of the results of the
+// operations are rounded outwards by one unit in the last place, so the
+// result contains the exact value of the operation for every point of the
+// operands. The division by an interval with zero gives the whole line.
+struct TInterval
+{
+    double lo;
+    double hi;
+
+    TInterval(double v = 0)
+        : lo { v },
+          hi { v }
+    {}
+
+    TInterval(double l, double h)
+        : lo { l },
+          hi { h }
+    {}
+
+    double getMid() const
+    {
+        return lo + 0.5 * (hi - lo);
+    }
+
+    double getWidth() const
+    {
+        return hi - lo;
+    }
+
+    bool contains(double x) const
+    {
+        return lo <= x and x <= hi;
+    }
+
+    // Method to check that the interval is inside (lo, hi).
+    bool isInterior(const TInterval& outer) const
+    {
+        return outer.lo < lo and hi < outer.hi;
+    }
+};
+
+TInterval operator-(const TInterval& i);
+TInterval operator+(const TInterval& lhs, const TInterval& rhs);
+TInterval operator-(const TInterval& lhs, const TInterval& rhs);
+TInterval operator*(const TInterval& lhs, const TInterval& rhs);
+TInterval operator/(const TInterval& lhs, const TInterval& rhs);
+TInterval exp(const TInterval& i);
+
+// Function to get the intersection of the intervals, empty if they do not
+// intersect.
+std::optional<TInterval> intersect(const TInterval& lhs,
+                                   const TInterval& rhs);
+
+
+// Enclosures of the value and the derivative of the function on the
+// interval, the interval analogue of TDual.
+struct TIntervalDual
+{
+    TInterval val;
+    TInterval deriv;
+
+    TIntervalDual(const TInterval& v = 0, const TInterval& d = 0)
+        : val { v },
+          deriv { d }
+    {}
+
+    TIntervalDual(double v)
+        : val { v },
+          deriv { 0 }
+    {}
+};
+
+TIntervalDual operator+(const TIntervalDual& lhs, const TIntervalDual& rhs);
+TIntervalDual operator-(const TIntervalDual& lhs, const TIntervalDual& rhs);
+TIntervalDual operator*(const TIntervalDual& lhs, const TIntervalDual& rhs);
+TIntervalDual operator/(const TIntervalDual& lhs, const TIntervalDual& rhs);
+TIntervalDual exp(const TIntervalDual& d);
+
+
+// Interval extension of the function built from the basic functions by the
+// arithmetic operators, including the exponent part of the basic functions.
+// The function is compiled to TTape, the instructions are evaluated in
+// interval arithmetic. The enclosures of the Horner scheme may be wider than
+// the ranges of the functions, but they always contain them. Throws
+// std::logic_error if the function has parts which are not basic and not
+// composite, since their ranges are unknown.
+class TIntervalFunction
+{
+public:
+    explicit TIntervalFunction(const TFunction& f);
+
+    TInterval operator()(const TInterval& x) const;
+    TIntervalDual getValDeriv(const TInterval& x) const;
+
+private:
+    TTape tape_;
+
+    template<class T>
+    T run(const T& x, T* slots) const;
+
+    template<class T>
+    T evaluate(const T& x) const;
+};
+
+
+// Interval enclosure of the root.
+struct TRootEnclosure
+{
+    TInterval x;
+
+    // The enclosure contains exactly one root. Otherwise it is narrower than
+    // eps, may contain roots and can not be split further, e.g. it is at a
+    // multiple root.
+    bool unique;
+};
+
+
+// Result of the interval solver.
+struct TIntervalSolveResult
+{
+    // Enclosures of the roots in the ascending order.
+    std::vector<TRootEnclosure> roots;
+
+    // The whole interval is examined, so every root is in one of the
+    // enclosures. It is false if the boxes are over.
+    bool complete = true;
+};
+
+
+// Class to find all roots of the function on [a, b] with guaranteed
+// enclosures by the interval Newton method. A box where the enclosure of f
+// does not contain zero has no roots and is dropped. If the enclosure of
+// f' does not contain zero, the Newton operator N(X) = m - f(m) / f'(X) of
+// the midpoint m contains every root of X. So X is replaced by the
+// intersection with N(X), and if N(X) is inside X the root exists and is
+// unique. Otherwise the box is bisected.
+class IntervalSolver
+{
+public:
+    // Roots are enclosed with the width eps. At most max_boxes boxes are
+    // examined.
+    IntervalSolver(double eps = 1e-10, unsigned max_boxes = 100000)
+        : eps_ { eps },
+          max_boxes_ { max_boxes }
+    {}
+
+    // Method to get the enclosures of all roots of f on [a, b]. Throws
+    // std::logic_error if f has no interval extension or [a, b] is not a
+    // finite interval.
+    TIntervalSolveResult solveEquation(const TFunction& f,
+                                       double a,
+                                       double b) const;
+
+private:
+    double eps_;
+    unsigned max_boxes_;
+};
+
+
+#endif
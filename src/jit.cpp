@@ -0,0 +1,512 @@
+#include "jit.hpp"
+
+#include <sstream>
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+
+// Flags to compile the generated code. The objects may be loaded on another
+// machine sharing the cache directory, so they are built for the generic
+// target of the compiler.
+#define JIT_FLAGS { "-O2", "-std=c++17", "-shared", "-fPIC" }
+
+
+extern char** environ;
+
+
+// Function to get the C++ literal of the number. Hexadecimal literals keep
+// every bit of the coefficient.
+static std::string getLiteral(double c)
+{
+    if (std::isnan(c)) {
+        return "__builtin_nan(\"\")";
+    }
+
+    if (std::isinf(c)) {
+        return c > 0 ? "__builtin_inf()" : "(-__builtin_inf())";
+    }
+
+    std::stringstream res;
+    res << "(" << std::hexfloat << c << ")";
+
+    return res.str();
+}
+
+// Function to get the statements of the Horner scheme for the instruction.
+// If dual is true the derivative is computed too.
+static std::string getPolySource(const TTape::TInstr& instr,
+                                 const VectOfDouble& coeffs,
+                                 bool dual)
+{
+    std::stringstream res;
+    const double* c = &coeffs[instr.arg];
+
+    res << "    {\n"
+        << "        double v = 0;\n";
+
+    if (dual) {
+        res << "        double d = 0;\n";
+    }
+
+    for (std::size_t i = instr.size; i > 1; i--) {
+        if (dual) {
+            res << "        d = d * x + v;\n";
+        }
+
+        res << "        v = v * x + " << getLiteral(c[i - 1]) << ";\n";
+    }
+
+    if (instr.size > 0 and c[0] != 0) {
+        res << "        double p = " << getLiteral(c[0]) << " * e;\n"
+            << "        v += p;\n";
+
+        if (dual) {
+            res << "        d += p;\n";
+        }
+    }
+
+    res << "        s" << instr.dst << " = v;\n";
+
+    if (dual) {
+        res << "        d" << instr.dst << " = d;\n";
+    }
+
+    res << "    }\n";
+
+    return res.str();
+}
+
+std::string TJit::generateSource(const TTape& tape)
+{
+    const auto& instrs = tape.getInstrs();
+    const auto& coeffs = tape.getCoeffs();
+    std::size_t slots_num = tape.getSlotsNum();
+
+    // The exponent is computed once for all basic functions.
+    bool need_exp = false;
+    for (const auto& instr : instrs) {
+        if (instr.code == TTape::TOpCode::Call) {
+            throw std::logic_error("Error: Function can not be compiled");
+        }
+
+        if (instr.code == TTape::TOpCode::Poly and
+                instr.size > 0 and coeffs[instr.arg] != 0) {
+
+            need_exp = true;
+        }
+    }
+
+    std::stringstream res;
+    res << "#include <cmath>\n"
+        << "#include <cstddef>\n\n";
+
+    // Value and derivative functions.
+    for (bool dual : { false, true }) {
+        if (dual) {
+            res << "static inline void valDeriv(double x, "
+                << "double* val, double* deriv)\n";
+        } else {
+            res << "static inline double val(double x)\n";
+        }
+
+        res << "{\n";
+
+        if (need_exp) {
+            res << "    const double e = std::exp(x);\n";
+        }
+
+        for (std::size_t i = 0; i < slots_num; i++) {
+            res << "    double s" << i << ";\n";
+            if (dual) {
+                res << "    double d" << i << ";\n";
+            }
+        }
+
+        for (const auto& instr : instrs) {
+            std::string l = std::to_string(instr.lhs);
+            std::string r = std::to_string(instr.rhs);
+            std::string dst = std::to_string(instr.dst);
+
+            // Binary operations read the operands before the destination
+            // slot is written, because it may be one of them.
+            std::string read_ops =
+                    "        double l = s" + l + ";\n" +
+                    "        double r = s" + r + ";\n" +
+                    (dual ? "        double ld = d" + l + ";\n" +
+                            "        double rd = d" + r + ";\n"
+                          : "");
+
+            switch (instr.code) {
+              case TTape::TOpCode::Const: {
+                res << "    s" << dst << " = "
+                    << getLiteral(coeffs[instr.arg]) << ";\n";
+                if (dual) {
+                    res << "    d" << dst << " = 0;\n";
+                }
+                break;
+              }
+              case TTape::TOpCode::Poly: {
+                res << getPolySource(instr, coeffs, dual);
+                break;
+              }
+              case TTape::TOpCode::Add: {
+                res << "    {\n" << read_ops
+                    << "        s" << dst << " = l + r;\n";
+                if (dual) {
+                    res << "        d" << dst << " = ld + rd;\n";
+                }
+                res << "    }\n";
+                break;
+              }
+              case TTape::TOpCode::Sub: {
+                res << "    {\n" << read_ops
+                    << "        s" << dst << " = l - r;\n";
+                if (dual) {
+                    res << "        d" << dst << " = ld - rd;\n";
+                }
+                res << "    }\n";
+                break;
+              }
+              case TTape::TOpCode::Mul: {
+                res << "    {\n" << read_ops
+                    << "        s" << dst << " = l * r;\n";
+                if (dual) {
+                    res << "        d" << dst << " = ld * r + l * rd;\n";
+                }
+                res << "    }\n";
+                break;
+              }
+              case TTape::TOpCode::Div: {
+                res << "    {\n" << read_ops
+                    << "        s" << dst << " = l / r;\n";
+                if (dual) {
+                    res << "        d" << dst
+                        << " = (ld * r - l * rd) / (r * r);\n";
+                }
+                res << "    }\n";
+                break;
+              }
+              default: {
+                break;
+              }
+            }
+        }
+
+        std::string result = std::to_string(tape.getResultSlot());
+        if (dual) {
+            res << "    *val = s" << result << ";\n"
+                << "    *deriv = d" << result << ";\n";
+        } else {
+            res << "    return s" << result << ";\n";
+        }
+
+        res << "}\n\n";
+    }
+
+    // Exported functions.
+    res << "extern \"C\" double jit_val(double x)\n"
+        << "{\n"
+        << "    return val(x);\n"
+        << "}\n\n"
+        << "extern \"C\" void jit_val_deriv(double x, "
+        << "double* v, double* d)\n"
+        << "{\n"
+        << "    valDeriv(x, v, d);\n"
+        << "}\n\n"
+        << "extern \"C\" void jit_val_batch(const double* xs, "
+        << "double* out, std::size_t n)\n"
+        << "{\n"
+        << "    for (std::size_t i = 0; i < n; i++) {\n"
+        << "        out[i] = val(xs[i]);\n"
+        << "    }\n"
+        << "}\n\n"
+        << "extern \"C\" void jit_val_deriv_batch(const double* xs, "
+        << "double* v, double* d, std::size_t n)\n"
+        << "{\n"
+        << "    for (std::size_t i = 0; i < n; i++) {\n"
+        << "        valDeriv(xs[i], v + i, d + i);\n"
+        << "    }\n"
+        << "}\n";
+
+    return res.str();
+}
+
+
+std::string TJit::getDefaultCacheDir()
+{
+    const char* dir = std::getenv("EQSOLVER_JIT_CACHE");
+    if (dir != nullptr) {
+        return dir;
+    }
+
+    // Every user has an own directory, see checkOwnership().
+    std::string name = "eqsolver-jit-" + std::to_string(geteuid());
+
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+
+// Function to check that the file is owned by the user and can not be
+// written by others, so nobody else can plant the code loaded by dlopen.
+static void checkOwnership(const std::filesystem::path& path, bool is_dir)
+{
+    struct stat st;
+    if (lstat(path.c_str(), &st) != 0) {
+        throw std::runtime_error("Error: JIT cache " + path.string() + ": " +
+                                 std::strerror(errno));
+    }
+
+    bool valid_type = is_dir ? S_ISDIR(st.st_mode) : S_ISREG(st.st_mode);
+    if (not valid_type or st.st_uid != geteuid() or
+            (st.st_mode & (S_IWGRP | S_IWOTH)) != 0) {
+
+        throw std::runtime_error("Error: Insecure JIT cache " +
+                                 path.string());
+    }
+}
+
+// Function to create the cache directory accessible by the user only and to
+// check the existing one.
+static void prepareCacheDir(const std::filesystem::path& dir)
+{
+    if (dir.has_parent_path()) {
+        std::filesystem::create_directories(dir.parent_path());
+    }
+
+    if (mkdir(dir.c_str(), 0700) != 0 and errno != EEXIST) {
+        throw std::runtime_error("Error: JIT cache " + dir.string() + ": " +
+                                 std::strerror(errno));
+    }
+
+    checkOwnership(dir, true);
+}
+
+// Function to run the compiler without the shell, so the paths and the
+// compiler name are never parsed as commands. The output goes to the log.
+static bool runCompiler(const std::string& compiler,
+                        const std::string& obj_path,
+                        const std::string& src_path,
+                        const std::string& log_path)
+{
+    std::vector<std::string> args = { compiler };
+    for (const char* flag : JIT_FLAGS) {
+        args.push_back(flag);
+    }
+
+    args.insert(args.end(), { "-o", obj_path, src_path });
+
+    std::vector<char*> argv;
+    for (auto& arg : args) {
+        argv.push_back(arg.data());
+    }
+
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions,
+                                     STDOUT_FILENO,
+                                     log_path.c_str(),
+                                     O_WRONLY | O_CREAT | O_TRUNC,
+                                     0600);
+    posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+
+    pid_t pid;
+    int err = posix_spawnp(&pid,
+                           compiler.c_str(),
+                           &actions,
+                           nullptr,
+                           argv.data(),
+                           environ);
+    posix_spawn_file_actions_destroy(&actions);
+
+    if (err != 0) {
+        return false;
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+
+    return WIFEXITED(status) and WEXITSTATUS(status) == 0;
+}
+
+std::string TJit::getHash(const std::string& source) const
+{
+    // 64-bit FNV-1a hash of the code and the command, since a different
+    // compiler gives a different object.
+    std::uint64_t hash = 14695981039346656037ull;
+    std::string flags;
+    for (const char* flag : JIT_FLAGS) {
+        flags += std::string(flag) + " ";
+    }
+
+    for (const std::string& str : { source, compiler_, flags }) {
+        for (unsigned char c : str) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+    }
+
+    std::stringstream res;
+    res << std::hex << hash;
+
+    return res.str();
+}
+
+std::string TJit::getObjectPath(const TFunction& f) const
+{
+    std::string source = generateSource(TTape(f));
+    std::filesystem::path path = cache_dir_;
+
+    return (path / (getHash(source) + ".so")).string();
+}
+
+
+std::unique_ptr<TFunction> TJit::compile(const TFunction& f) const
+{
+    std::string source = generateSource(TTape(f));
+    std::string hash = getHash(source);
+
+    std::filesystem::path dir = cache_dir_;
+    std::filesystem::path obj_path = dir / (hash + ".so");
+
+    prepareCacheDir(dir);
+
+    if (not std::filesystem::exists(obj_path)) {
+        // Compile to the files with the unique name and rename the object at
+        // the end, so concurrent compilations do not see partial files. The
+        // source file is created exclusively, so the name is not used by
+        // other threads or processes until the file is removed.
+        std::string src_name = (dir / (hash + ".XXXXXX.cpp")).string();
+        int fd = mkstemps(src_name.data(), 4);
+        if (fd < 0) {
+            throw std::runtime_error("Error: JIT cache " + dir.string() +
+                                     ": " + std::strerror(errno));
+        }
+
+        close(fd);
+
+        std::filesystem::path src_path = src_name;
+        std::filesystem::path tmp_obj_path = src_path;
+        std::filesystem::path log_path = src_path;
+        tmp_obj_path.replace_extension(".so");
+        log_path.replace_extension(".log");
+
+        std::ofstream(src_path) << source;
+
+        bool success = runCompiler(compiler_,
+                                   tmp_obj_path.string(),
+                                   src_path.string(),
+                                   log_path.string());
+
+        if (not success) {
+            std::filesystem::remove(tmp_obj_path);
+            std::filesystem::remove(src_path);
+            throw std::runtime_error("Error: JIT compilation failed, see " +
+                                     log_path.string());
+        }
+
+        // The mode given by the umask may let the group write the object.
+        std::filesystem::permissions(tmp_obj_path,
+                                     std::filesystem::perms::owner_all);
+
+        std::filesystem::remove(log_path);
+        std::filesystem::rename(tmp_obj_path, obj_path);
+        std::filesystem::remove(src_path);
+    }
+
+    checkOwnership(obj_path, false);
+
+    std::shared_ptr<void> handle(dlopen(obj_path.c_str(),
+                                        RTLD_NOW | RTLD_LOCAL),
+    [](void* h)
+    {
+        if (h != nullptr) {
+            dlclose(h);
+        }
+    });
+
+    if (handle == nullptr) {
+        throw std::runtime_error(std::string("Error: ") + dlerror());
+    }
+
+    using ValFn = double (*)(double);
+    using ValDerivFn = void (*)(double, double*, double*);
+    using ValBatchFn = void (*)(const double*, double*, std::size_t);
+    using ValDerivBatchFn = void (*)(const double*,
+                                     double*,
+                                     double*,
+                                     std::size_t);
+
+    auto val = reinterpret_cast<ValFn>(dlsym(handle.get(), "jit_val"));
+    auto val_deriv = reinterpret_cast<ValDerivFn>(
+            dlsym(handle.get(), "jit_val_deriv"));
+    auto val_batch = reinterpret_cast<ValBatchFn>(
+            dlsym(handle.get(), "jit_val_batch"));
+    auto val_deriv_batch = reinterpret_cast<ValDerivBatchFn>(
+            dlsym(handle.get(), "jit_val_deriv_batch"));
+
+    if (val == nullptr or val_deriv == nullptr or
+            val_batch == nullptr or val_deriv_batch == nullptr) {
+
+        throw std::runtime_error("Error: Invalid JIT object " +
+                                 obj_path.string());
+    }
+
+    // Every functor keeps the shared object loaded.
+    auto res = std::make_unique<IPolynomial>(
+    [handle, val](double x)
+    {
+        return val(x);
+    },
+    [handle, val_deriv](double x)
+    {
+        double v;
+        double d;
+        val_deriv(x, &v, &d);
+
+        return d;
+    },
+    [handle, val_deriv](double x)
+    {
+        double v;
+        double d;
+        val_deriv(x, &v, &d);
+
+        return TDual(v, d);
+    });
+
+    res->get_val_batch_ftor_ =
+    [handle, val_batch](const double* xs, double* out, std::size_t n)
+    {
+        val_batch(xs, out, n);
+    };
+
+    res->get_val_deriv_batch_ftor_ =
+    [handle, val_deriv_batch](const double* xs,
+                              double* val_out,
+                              double* deriv_out,
+                              std::size_t n)
+    {
+        val_deriv_batch(xs, val_out, deriv_out, n);
+    };
+
+    return res;
+}
@@ -0,0 +1,62 @@
+#ifndef JIT_HEADER
+#define JIT_HEADER
+
+
+#include "functions.hpp"
+#include "tape.hpp"
+
+#include <string>
+#include <memory>
+
+
+// Compiler used for the native code. The Makefile passes its own compiler.
+#ifndef JIT_COMPILER
+#define JIT_COMPILER "g++"
+#endif
+
+
+// Opt-in native compilation of functions built by the arithmetic operators.
+// The tape of the function is translated to C++ code for the value and the
+// derivative, compiled by the C++ compiler into a shared object and loaded by
+// dlopen. Shared objects are cached on disk under the hash of the generated
+// code, so the same expression is compiled once. The compiler is run without
+// the shell, so it is the name or the path of the program. The cache
+// directory is created accessible by the user only, and the directory and
+// the objects owned by other users or writable by others are never loaded.
+class TJit
+{
+public:
+    TJit(const std::string& cache_dir = getDefaultCacheDir(),
+         const std::string& compiler = JIT_COMPILER)
+
+        : cache_dir_ { cache_dir },
+          compiler_ { compiler }
+    {}
+
+    // Method to get the compiled function. Throws std::logic_error if the
+    // function has parts which are not basic and not built by the operators,
+    // and std::runtime_error if the code can not be compiled or loaded or the
+    // cache directory is not safe.
+    std::unique_ptr<TFunction> compile(const TFunction& f) const;
+
+    // Method to get the path of the shared object for the function. The file
+    // exists if the function has been compiled before.
+    std::string getObjectPath(const TFunction& f) const;
+
+    // Method to get the C++ code generated for the tape.
+    static std::string generateSource(const TTape& tape);
+
+    // The default cache directory is $EQSOLVER_JIT_CACHE or the directory of
+    // the user in the system temporary directory.
+    static std::string getDefaultCacheDir();
+
+private:
+    std::string cache_dir_;
+    std::string compiler_;
+
+    // Method to get the hash of the code and the compiler command.
+    std::string getHash(const std::string& source) const;
+};
+
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef MEMO_HEADER
+#define MEMO_HEADER
+
+
+#include "functions.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+// Memo of the evaluations of the function in the direct-mapped table of
+// SlotsNum slots indexed by the bits of x. Repeated queries of the value and
+// of the derivative at the same point do not evaluate the function again, a
+// value query hits the slot filled by a derivative query, and a derivative
+// query at the point of a memoized value evaluates only the derivative. One
+// slot gives the cache of the last point. The table is inside the object, so
+// the memo never allocates memory. It is not thread safe, and the function
+// must outlive it.
+template<std::size_t SlotsNum = 16>
+class TEvalMemo
+{
+    static_assert(SlotsNum != 0 and (SlotsNum & (SlotsNum - 1)) == 0,
+                  "Number of slots must be a power of two");
+
+public:
+    explicit TEvalMemo(const TFunction* f = nullptr)
+        : f_ { f }
+    {}
+
+    // Method to memoize f from scratch, the slots and the counters are
+    // cleared.
+    void reset(const TFunction* f)
+    {
+        f_ = f;
+        hits_num_ = 0;
+        evals_num_ = 0;
+        derivs_num_ = 0;
+
+        for (auto& slot : slots_) {
+            slot.state = TState::Empty;
+        }
+    }
+
+    double getVal(double x)
+    {
+        TSlot& slot = getSlot(x);
+        if (slot.state != TState::Empty and isSame(slot.x, x)) {
+            hits_num_++;
+            return slot.val.val;
+        }
+
+        evals_num_++;
+        slot = { x, TDual((*f_)(x), 0), TState::Val };
+
+        return slot.val.val;
+    }
+
+    TDual getValDeriv(double x)
+    {
+        TSlot& slot = getSlot(x);
+        if (slot.state != TState::Empty and isSame(slot.x, x)) {
+            hits_num_++;
+
+            if (slot.state == TState::Val) {
+                derivs_num_++;
+                slot.val.deriv = f_->getDeriv(x);
+                slot.state = TState::ValDeriv;
+            }
+
+            return slot.val;
+        }
+
+        evals_num_++;
+        derivs_num_++;
+        slot = { x, f_->getValDeriv(x), TState::ValDeriv };
+
+        return slot.val;
+    }
+
+    // Number of the queries taken from the memo.
+    unsigned getHitsNum() const
+    {
+        return hits_num_;
+    }
+
+    // Number of the evaluations of the function and of the derivative. The
+    // derivative at the point of a memoized value is counted as a hit and
+    // a derivative evaluation.
+    unsigned getEvalsNum() const
+    {
+        return evals_num_;
+    }
+
+    unsigned getDerivsNum() const
+    {
+        return derivs_num_;
+    }
+
+    // Fraction of the queries taken from the memo, zero before the queries.
+    double getHitRate() const
+    {
+        unsigned queries_num = hits_num_ + evals_num_;
+
+        return queries_num != 0 ? static_cast<double>(hits_num_) / queries_num
+                                : 0;
+    }
+
+private:
+    enum class TState : std::uint8_t
+    {
+        Empty,
+        Val,
+        ValDeriv
+    };
+
+    struct TSlot
+    {
+        double x;
+        TDual val;
+        TState state = TState::Empty;
+    };
+
+    const TFunction* f_;
+    TSlot slots_[SlotsNum];
+    unsigned hits_num_ = 0;
+    unsigned evals_num_ = 0;
+    unsigned derivs_num_ = 0;
+
+    static std::uint64_t getBits(double x)
+    {
+        std::uint64_t res;
+        std::memcpy(&res, &x, sizeof(res));
+
+        return res;
+    }
+
+    // The points are compared by the bits, so NaN is found and -0 is not 0.
+    static bool isSame(double lhs, double rhs)
+    {
+        return getBits(lhs) == getBits(rhs);
+    }
+
+    TSlot& getSlot(double x)
+    {
+        // The high bits of the Fibonacci hash mix all bits of x.
+        std::uint64_t hash = getBits(x) * 0x9e3779b97f4a7c15ull;
+
+        return slots_[(hash >> 32) & (SlotsNum - 1)];
+    }
+};
+
+
+#endif
@@ -0,0 +1,570 @@
+#include "polyroots.hpp"
+#include "eqsolution.hpp"
+
+#include <cfloat>
+
+
+// Relative size of the remainder in the Sturm sequence which is treated as
+// zero.
+#define STURM_ZERO_TOL (64 * DBL_EPSILON)
+
+// Number of the lanes of PolyBatchSolver, two AVX2 or one AVX-512 register
+// of doubles.
+#define POLY_BATCH_LANES 8
+
+
+// Function to get the coefficients of 1, x, x^2, ... of the polynomial up
+// to the leading nonzero one.
+static VectOfDouble getPolyCoeffs(const IPolynomial& f)
+{
+    const auto& c_v = f.getCoeffVect();
+    if (not f.isBasic() or (not c_v.empty() and c_v[0] != 0)) {
+        throw std::logic_error("Error: Function is not a polynomial");
+    }
+
+    VectOfDouble a(c_v.begin() + std::min<std::size_t>(1, c_v.size()),
+                   c_v.end());
+    while (not a.empty() and a.back() == 0) {
+        a.pop_back();
+    }
+
+    if (a.empty()) {
+        throw std::logic_error("Error: Function is zero");
+    }
+
+    return a;
+}
+
+
+// Horner scheme for the polynomial a and its derivative at the n points
+// (re, im). bound gets sum |a_k| |z|^k, which bounds the rounding error.
+static void polyValDerivComplex(const VectOfDouble& a,
+                                const double* re,
+                                const double* im,
+                                double* p_re,
+                                double* p_im,
+                                double* dp_re,
+                                double* dp_im,
+                                double* bound,
+                                std::size_t n)
+{
+    std::size_t deg = a.size() - 1;
+
+    // Moduli are computed once, sqrt is not vectorized with errno.
+    VectOfDouble abs_z(n);
+    for (std::size_t i = 0; i < n; i++) {
+        abs_z[i] = std::sqrt(re[i] * re[i] + im[i] * im[i]);
+    }
+
+    #pragma omp simd
+    for (std::size_t i = 0; i < n; i++) {
+        p_re[i] = a[deg];
+        p_im[i] = 0;
+        dp_re[i] = 0;
+        dp_im[i] = 0;
+        bound[i] = std::abs(a[deg]);
+    }
+
+    for (std::size_t k = deg; k > 0; k--) {
+        double c = a[k - 1];
+        double abs_c = std::abs(c);
+
+        #pragma omp simd
+        for (std::size_t i = 0; i < n; i++) {
+            double d_re = dp_re[i] * re[i] - dp_im[i] * im[i] + p_re[i];
+            double d_im = dp_re[i] * im[i] + dp_im[i] * re[i] + p_im[i];
+            double v_re = p_re[i] * re[i] - p_im[i] * im[i] + c;
+            double v_im = p_re[i] * im[i] + p_im[i] * re[i];
+
+            dp_re[i] = d_re;
+            dp_im[i] = d_im;
+            p_re[i] = v_re;
+            p_im[i] = v_im;
+            bound[i] = bound[i] * abs_z[i] + abs_c;
+        }
+    }
+
+    // Rounding error of the complex Horner scheme.
+    double mu = 4 * deg * DBL_EPSILON;
+
+    #pragma omp simd
+    for (std::size_t i = 0; i < n; i++) {
+        bound[i] *= mu;
+    }
+}
+
+
+std::vector<TPolyRoot> getPolyRoots(const IPolynomial& f, unsigned max_iter)
+{
+    VectOfDouble a = getPolyCoeffs(f);
+
+    // Zero roots are exact.
+    std::vector<TPolyRoot> res;
+    std::size_t zeros_num = 0;
+    while (a[zeros_num] == 0) {
+        zeros_num++;
+    }
+
+    res.assign(zeros_num, { 0, 0 });
+    a.erase(a.begin(), a.begin() + zeros_num);
+
+    std::size_t n = a.size() - 1;
+    if (n == 0) {
+        return res;
+    }
+
+    // Root estimates on the circle around the centroid of the roots. The
+    // radius is the geometric mean of the distances to the roots, the
+    // angles are shifted to break the symmetry of the coefficients.
+    std::complex<double> center = -a[n - 1] / (n * a[n]);
+    std::complex<double> p_center = a[n];
+    for (std::size_t k = n; k > 0; k--) {
+        p_center = p_center * center + a[k - 1];
+    }
+
+    double radius = std::pow(std::abs(p_center / a[n]), 1.0 / n);
+    if (not std::isfinite(radius) or radius == 0) {
+        radius = 1;
+    }
+
+    VectOfDouble re(n);
+    VectOfDouble im(n);
+    for (std::size_t i = 0; i < n; i++) {
+        double angle = 2 * M_PI * i / n + 0.4;
+        re[i] = center.real() + radius * std::cos(angle);
+        im[i] = center.imag() + radius * std::sin(angle);
+    }
+
+    VectOfDouble p_re(n);
+    VectOfDouble p_im(n);
+    VectOfDouble dp_re(n);
+    VectOfDouble dp_im(n);
+    VectOfDouble bound(n);
+    VectOfDouble w_re(n);
+    VectOfDouble w_im(n);
+    std::vector<bool> done(n, false);
+
+    for (unsigned k = 0; k < max_iter; k++) {
+        polyValDerivComplex(a,
+                            re.data(),
+                            im.data(),
+                            p_re.data(),
+                            p_im.data(),
+                            dp_re.data(),
+                            dp_im.data(),
+                            bound.data(),
+                            n);
+
+        bool all_done = true;
+        for (std::size_t i = 0; i < n; i++) {
+            if (not done[i]) {
+                done[i] = std::hypot(p_re[i], p_im[i]) <= bound[i];
+                all_done = all_done and done[i];
+            }
+        }
+
+        if (all_done) {
+            break;
+        }
+
+        // Aberth corrections w = r / (1 - r * s), where r = p / p' and s is
+        // the sum of 1 / (z_i - z_j) over the other estimates. All
+        // corrections use the estimates of the previous iteration.
+        for (std::size_t i = 0; i < n; i++) {
+            w_re[i] = 0;
+            w_im[i] = 0;
+
+            if (done[i]) {
+                continue;
+            }
+
+            double s_re = 0;
+            double s_im = 0;
+
+            #pragma omp simd reduction(+:s_re, s_im)
+            for (std::size_t j = 0; j < n; j++) {
+                double d_re = re[i] - re[j];
+                double d_im = im[i] - im[j];
+                double inv = j == i ? 0 : 1 / (d_re * d_re + d_im * d_im);
+                s_re += d_re * inv;
+                s_im -= d_im * inv;
+            }
+
+            std::complex<double> r = std::complex<double>(p_re[i], p_im[i]) /
+                                     std::complex<double>(dp_re[i], dp_im[i]);
+            std::complex<double> w = r / (1.0 - r * std::complex<double>(s_re,
+                                                                         s_im));
+
+            if (std::isfinite(w.real()) and std::isfinite(w.imag())) {
+                w_re[i] = w.real();
+                w_im[i] = w.imag();
+            }
+        }
+
+        #pragma omp simd
+        for (std::size_t i = 0; i < n; i++) {
+            re[i] -= w_re[i];
+            im[i] -= w_im[i];
+        }
+    }
+
+    // Inclusion radii from the values at the final estimates.
+    polyValDerivComplex(a,
+                        re.data(),
+                        im.data(),
+                        p_re.data(),
+                        p_im.data(),
+                        dp_re.data(),
+                        dp_im.data(),
+                        bound.data(),
+                        n);
+
+    for (std::size_t i = 0; i < n; i++) {
+        std::complex<double> z(re[i], im[i]);
+        std::complex<double> prod = a[n];
+        for (std::size_t j = 0; j < n; j++) {
+            if (j != i) {
+                prod *= z - std::complex<double>(re[j], im[j]);
+            }
+        }
+
+        double p_abs = std::hypot(p_re[i], p_im[i]) + bound[i];
+        res.push_back({ z, n * p_abs / std::abs(prod) });
+    }
+
+    return res;
+}
+
+
+TSturmSequence::TSturmSequence(const IPolynomial& f)
+{
+    polys_.push_back(getPolyCoeffs(f));
+
+    // Derivative.
+    const VectOfDouble& p = polys_[0];
+    if (p.size() > 1) {
+        VectOfDouble deriv(p.size() - 1);
+        for (std::size_t i = 1; i < p.size(); i++) {
+            deriv[i - 1] = i * p[i];
+        }
+
+        polys_.push_back(deriv);
+    }
+
+    // p_{k+1} = -rem(p_{k-1}, p_k) until the remainder is zero.
+    while (polys_.back().size() > 1) {
+        VectOfDouble rem = polys_[polys_.size() - 2];
+        const VectOfDouble& div = polys_.back();
+
+        double max_coeff = 0;
+        for (double c : rem) {
+            max_coeff = std::max(max_coeff, std::abs(c));
+        }
+
+        for (std::size_t i = rem.size(); i >= div.size(); i--) {
+            double q = rem[i - 1] / div.back();
+            for (std::size_t j = 0; j < div.size(); j++) {
+                rem[i - div.size() + j] -= q * div[j];
+            }
+        }
+
+        rem.resize(div.size() - 1);
+
+        // Coefficients below the cancellation error are zeros.
+        double rem_max = 0;
+        for (auto& c : rem) {
+            if (std::abs(c) <= STURM_ZERO_TOL * max_coeff) {
+                c = 0;
+            }
+
+            rem_max = std::max(rem_max, std::abs(c));
+        }
+
+        while (not rem.empty() and rem.back() == 0) {
+            rem.pop_back();
+        }
+
+        if (rem.empty()) {
+            break;
+        }
+
+        for (auto& c : rem) {
+            c = -c / rem_max;
+        }
+
+        polys_.push_back(rem);
+    }
+}
+
+unsigned TSturmSequence::getSignChangesNum(double x) const
+{
+    unsigned res = 0;
+    int prev_sign = 0;
+
+    for (const auto& p : polys_) {
+        double val;
+
+        // At infinity the sign is given by the leading term.
+        if (std::isinf(x)) {
+            val = p.back();
+            if (x < 0 and p.size() % 2 == 0) {
+                val = -val;
+            }
+
+        } else {
+            val = 0;
+            for (std::size_t i = p.size(); i > 0; i--) {
+                val = val * x + p[i - 1];
+            }
+        }
+
+        int sign = (val > 0) - (val < 0);
+        if (sign != 0) {
+            if (prev_sign != 0 and sign != prev_sign) {
+                res++;
+            }
+
+            prev_sign = sign;
+        }
+    }
+
+    return res;
+}
+
+unsigned TSturmSequence::getRootsNum(double a, double b) const
+{
+    if (not (a < b)) {
+        return 0;
+    }
+
+    unsigned a_changes = getSignChangesNum(a);
+    unsigned b_changes = getSignChangesNum(b);
+
+    return a_changes > b_changes ? a_changes - b_changes : 0;
+}
+
+double TSturmSequence::getRootsBound() const
+{
+    // Cauchy bound 1 + max |a_i / a_n|.
+    const VectOfDouble& p = polys_[0];
+    double res = 0;
+    for (std::size_t i = 0; i + 1 < p.size(); i++) {
+        res = std::max(res, std::abs(p[i] / p.back()));
+    }
+
+    return 1 + res;
+}
+
+std::vector<TRootInterval> TSturmSequence::isolateRoots(double a,
+                                                        double b) const
+{
+    std::vector<TRootInterval> res;
+
+    // The roots are inside the bound, the bound itself is not a root.
+    double bound = getRootsBound();
+    a = std::max(a, -bound);
+    b = std::min(b, bound);
+
+    // Intervals to split with the numbers of the sign changes at the ends.
+    struct TItem
+    {
+        double a;
+        double b;
+        unsigned a_changes;
+        unsigned b_changes;
+    };
+
+    if (not (a < b)) {
+        return res;
+    }
+
+    std::vector<TItem> stack = { { a, b,
+                                   getSignChangesNum(a),
+                                   getSignChangesNum(b) } };
+    while (not stack.empty()) {
+        TItem item = stack.back();
+        stack.pop_back();
+
+        if (item.a_changes <= item.b_changes) {
+            continue;
+        }
+
+        unsigned roots_num = item.a_changes - item.b_changes;
+        double m = item.a + (item.b - item.a) / 2;
+
+        if (roots_num == 1 or not (m > item.a and m < item.b)) {
+            res.push_back({ item.a, item.b, roots_num });
+            continue;
+        }
+
+        unsigned m_changes = getSignChangesNum(m);
+
+        // The right half first, so the result is sorted.
+        stack.push_back({ m, item.b, m_changes, item.b_changes });
+        stack.push_back({ item.a, m, item.a_changes, m_changes });
+    }
+
+    return res;
+}
+
+
+void PolyBatchSolver::solveEquations(const double* coeffs,
+                                     std::size_t size,
+                                     std::size_t n,
+                                     std::optional<double>* roots) const
+{
+    if (size == 0) {
+        throw std::logic_error("Error: Empty coefficient vector");
+    }
+
+    constexpr std::size_t W = POLY_BATCH_LANES;
+    const double eps = eps_;
+    const unsigned max_iter = max_iter_;
+
+    // Coefficient j of the lane l is lane_coeffs[j * W + l].
+    std::vector<double> lane_coeffs(size * W, 0);
+
+    alignas(64) double x[W];
+    alignas(64) double step[W];
+    alignas(64) double prev_x[W];
+    alignas(64) double prev_val[W];
+    alignas(64) double val[W];
+    alignas(64) double deriv[W];
+    alignas(64) double exp_x[W];
+    alignas(64) int done[W];
+    alignas(64) int finished[W];
+    alignas(64) int active[W];
+    alignas(64) unsigned iters[W];
+    std::size_t eqs[W];
+
+    // The exponent is computed only if some equation has it.
+    bool has_exp = false;
+    for (std::size_t i = 0; i < n; i++) {
+        has_exp = has_exp or coeffs[i * size] != 0;
+    }
+
+    std::size_t next = 0;
+    std::size_t active_num = 0;
+
+    auto refill =
+    [&](std::size_t l)
+    {
+        active[l] = next < n;
+        if (not active[l]) {
+            return;
+        }
+
+        for (std::size_t j = 0; j < size; j++) {
+            lane_coeffs[j * W + l] = coeffs[next * size + j];
+        }
+
+        eqs[l] = next;
+        x[l] = init_x_;
+        step[l] = 1;
+        prev_x[l] = init_x_;
+        prev_val[l] = HUGE_VAL;
+        iters[l] = 0;
+        next++;
+        active_num++;
+    };
+
+    for (std::size_t l = 0; l < W; l++) {
+        x[l] = init_x_;
+        step[l] = 1;
+        prev_x[l] = init_x_;
+        prev_val[l] = HUGE_VAL;
+        refill(l);
+    }
+
+    EqSolver fallback(max_iter_, 0, eps_, EqSolver::Method::Newton);
+
+    while (active_num > 0) {
+        // Horner scheme for the value and the derivative in all lanes. The
+        // free lanes compute their last equation again.
+        #pragma omp simd
+        for (std::size_t l = 0; l < W; l++) {
+            val[l] = 0;
+            deriv[l] = 0;
+        }
+
+        for (std::size_t j = size - 1; j > 0; j--) {
+            const double* c = &lane_coeffs[j * W];
+
+            #pragma omp simd
+            for (std::size_t l = 0; l < W; l++) {
+                deriv[l] = deriv[l] * x[l] + val[l];
+                val[l] = val[l] * x[l] + c[l];
+            }
+        }
+
+        if (has_exp) {
+            for (std::size_t l = 0; l < W; l++) {
+                exp_x[l] = std::exp(x[l]);
+            }
+
+            #pragma omp simd
+            for (std::size_t l = 0; l < W; l++) {
+                double p = lane_coeffs[l] * exp_x[l];
+                val[l] += p;
+                deriv[l] += p;
+            }
+        }
+
+        // Newton step in the lanes which have not converged. If |f| has not
+        // decreased and has not changed the sign, the last step is halved
+        // from the previous point instead. The conditions are combined
+        // without branches, so the loop is vectorized. The lane has failed
+        // if x is not finite or the iterations are over.
+        int any_finished = 0;
+
+        #pragma omp simd reduction(|:any_finished)
+        for (std::size_t l = 0; l < W; l++) {
+            double v = val[l];
+            int decreased = (std::abs(v) < std::abs(prev_val[l])) |
+                            (v * prev_val[l] < 0);
+            int l_done = decreased &
+                         ((v == 0) | ((std::abs(v) < eps) &
+                                      (std::abs(step[l]) < eps)));
+
+            double new_step = decreased ? v / deriv[l] : 0.5 * step[l];
+            double base_x = decreased ? x[l] : prev_x[l];
+
+            prev_x[l] = base_x;
+            prev_val[l] = decreased ? v : prev_val[l];
+            step[l] = l_done ? step[l] : new_step;
+            x[l] = l_done ? x[l] : base_x - new_step;
+            iters[l]++;
+
+            int l_failed = (not (std::abs(x[l]) <= DBL_MAX)) |
+                           (iters[l] >= max_iter);
+
+            done[l] = l_done;
+            finished[l] = (l_done | l_failed) & active[l];
+            any_finished |= finished[l];
+        }
+
+        if (not any_finished) {
+            continue;
+        }
+
+        // Results of the finished lanes.
+        for (std::size_t l = 0; l < W; l++) {
+            if (not finished[l]) {
+                continue;
+            }
+
+            std::size_t eq = eqs[l];
+            if (done[l]) {
+                roots[eq] = x[l];
+
+            } else {
+                const double* c = coeffs + eq * size;
+                IPolynomial f(VectOfDouble(c, c + size));
+                roots[eq] = fallback.solveEquation(f, init_x_);
+            }
+
+            active_num--;
+            refill(l);
+        }
+    }
+}
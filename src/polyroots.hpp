@@ -0,0 +1,130 @@
+#ifndef POLYROOTS_HEADER
+#define POLYROOTS_HEADER
+
+
+#include "functions.hpp"
+
+#include <complex>
+#include <vector>
+#include <utility>
+#include <optional>
+
+
+// Root of the polynomial with the radius of the disc around it.
+struct TPolyRoot
+{
+    std::complex<double> val;
+    double error;
+};
+
+
+// Function to get all real and complex roots of the polynomial given by the
+// coefficient vector of IPolynomial without the exponent part. Roots are
+// found simultaneously by Aberth-Ehrlich iterations, one iteration costs
+// O(n^2) operations for the degree n and its loops over the root estimates
+// are vectorized. A root is not refined after the value at it is below the
+// rounding error of the Horner scheme.
+//
+// The errors are the inclusion radii n*|W_i| with the Weierstrass
+// corrections W_i computed from the rounding bound of the value: the union
+// of the discs contains all roots, and a connected component of m discs
+// contains exactly m roots. The root of the polynomial with real
+// coefficients is real if its disc does not overlap other discs and
+// crosses the real axis. Multiple roots converge slowly and get large
+// discs. Throws std::logic_error if the function is not a nonzero
+// polynomial.
+std::vector<TPolyRoot> getPolyRoots(const IPolynomial& f,
+                                    unsigned max_iter = 1000);
+
+
+
+// Interval (a, b] with roots_num distinct real roots of the polynomial.
+struct TRootInterval
+{
+    double a;
+    double b;
+    unsigned roots_num;
+};
+
+
+// Sturm sequence of the polynomial given by the coefficient vector of
+// IPolynomial without the exponent part. The number of distinct real roots
+// on (a, b] is the difference of the numbers of sign changes in the
+// sequence at a and b. The remainders are computed in floating point with
+// the normalized coefficients, which is reliable for moderate degrees and
+// roots which are not too close. Throws std::logic_error if the function is
+// not a nonzero polynomial.
+class TSturmSequence
+{
+public:
+    explicit TSturmSequence(const IPolynomial& f);
+
+    // Method to get the number of distinct real roots on (a, b]. The bounds
+    // may be infinite.
+    unsigned getRootsNum(double a, double b) const;
+
+    // Method to get the disjoint intervals with one distinct root each on
+    // (a, b] by bisection. The interval with several roots is returned if
+    // they are closer than the rounding error of the bounds. f changes the
+    // sign on the interval if its root there has odd multiplicity, so the
+    // intervals can be solved by EqSolver::solveEquation(f, a, b).
+    std::vector<TRootInterval> isolateRoots(double a = -HUGE_VAL,
+                                            double b = HUGE_VAL) const;
+
+    // Method to get the bound of the absolute values of the roots.
+    double getRootsBound() const;
+
+    const std::vector<VectOfDouble>& getPolys() const
+    {
+        return polys_;
+    }
+
+private:
+    // Polynomials of the sequence, coefficients of 1, x, x^2, ...
+    std::vector<VectOfDouble> polys_;
+
+    // Method to get the number of sign changes at x.
+    unsigned getSignChangesNum(double x) const;
+};
+
+
+
+// Newton solver for batches of polynomials of the same degree. The
+// equations are solved in lanes of a register width: the coefficients of
+// the lanes are kept in structure-of-arrays layout, and the Horner scheme
+// and the Newton step run for all lanes at once in vectorized loops. A lane
+// whose equation has converged or failed is refilled with the next equation
+// of the batch, so all lanes stay busy until the batch ends. The step is
+// halved while it does not decrease |f| as in EqSolver, but the lanes have
+// no other safeguards, so the equations which fail there are solved again
+// by EqSolver with Method::Newton. The convergence criterion is the one of
+// EqSolver.
+class PolyBatchSolver
+{
+public:
+    PolyBatchSolver(unsigned max_iter = 1000,
+                    double init_x = 1,
+                    double eps = 0.001)
+
+        : max_iter_ { max_iter },
+          init_x_ { init_x },
+          eps_ { eps }
+    {}
+
+    // Method to solve n equations with the coefficient vectors of
+    // IPolynomial of the given size stored one after another in coeffs.
+    // roots[i] gets the root of the i-th equation. Throws std::logic_error
+    // if size is zero.
+    void solveEquations(const double* coeffs,
+                        std::size_t size,
+                        std::size_t n,
+                        std::optional<double>* roots) const;
+
+private:
+    unsigned max_iter_;
+    double init_x_;
+    double eps_;
+};
+
+
+#endif
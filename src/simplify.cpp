@@ -0,0 +1,271 @@
+#include "simplify.hpp"
+
+#include <unordered_map>
+#include <map>
+#include <tuple>
+
+
+// Function to get the value if the coefficient vector is a constant.
+static std::optional<double> getConstant(const VectOfDouble& c_v)
+{
+    if (not c_v.empty() and c_v[0] != 0) {
+        return {};
+    }
+
+    for (std::size_t i = 2; i < c_v.size(); i++) {
+        if (c_v[i] != 0) {
+            return {};
+        }
+    }
+
+    return c_v.size() > 1 ? c_v[1] : 0;
+}
+
+
+// Builder of the simplified nodes. Every node is built from the operands
+// which are already simplified.
+class TSimplifier
+{
+public:
+    TSimplifier(TExprContext& ctx)
+        : ctx_ { ctx }
+    {}
+
+    const TFunction* build(TFunction::Operation op,
+                           const TFunction* lhs,
+                           const TFunction* rhs);
+
+    const TFunction* basic(VectOfDouble c_v)
+    {
+        // Trailing zeros are dropped, so equal functions are equal leaves.
+        while (c_v.size() > 1 and c_v.back() == 0) {
+            c_v.pop_back();
+        }
+
+        return &ctx_.basic(c_v);
+    }
+
+private:
+    TExprContext& ctx_;
+
+    // Nodes by their operations and operands.
+    std::map<std::tuple<TFunction::Operation,
+                        const TFunction*,
+                        const TFunction*>, const TFunction*> nodes_;
+
+    // Method to regroup the sum with one basic operand.
+    const TFunction* merge(TFunction::Operation op,
+                           const TFunction* lhs,
+                           const TFunction* rhs);
+};
+
+const TFunction* TSimplifier::build(TFunction::Operation op,
+                                    const TFunction* lhs,
+                                    const TFunction* rhs)
+{
+    using Operation = TFunction::Operation;
+
+    auto l_coeffs = getBasicCoeffs(*lhs);
+    auto r_coeffs = getBasicCoeffs(*rhs);
+
+    std::optional<double> l_const;
+    std::optional<double> r_const;
+    if (l_coeffs) {
+        l_const = getConstant(*l_coeffs);
+    }
+
+    if (r_coeffs) {
+        r_const = getConstant(*r_coeffs);
+    }
+
+    // Folding of basic operands.
+    if (l_coeffs and r_coeffs) {
+        switch (op) {
+          case Operation::Add: {
+            return basic(vectAddition(*l_coeffs, *r_coeffs));
+          }
+          case Operation::Sub: {
+            return basic(vectSubtraction(*l_coeffs, *r_coeffs));
+          }
+          case Operation::Mul: {
+            if (auto c_v = coeffMultiplication(*l_coeffs, *r_coeffs)) {
+                return basic(*c_v);
+            }
+            break;
+          }
+          default: {
+            if (r_const and *r_const != 0) {
+                VectOfDouble c_v = *l_coeffs;
+                for (auto& c : c_v) {
+                    c /= *r_const;
+                }
+
+                return basic(c_v);
+            }
+            break;
+          }
+        }
+    }
+
+    // Identities.
+    switch (op) {
+      case Operation::Add: {
+        if (l_const == 0.0) {
+            return rhs;
+        }
+
+        if (r_const == 0.0) {
+            return lhs;
+        }
+        break;
+      }
+      case Operation::Sub: {
+        if (r_const == 0.0) {
+            return lhs;
+        }
+
+        if (lhs == rhs) {
+            return basic({ 0 });
+        }
+        break;
+      }
+      case Operation::Mul: {
+        if (l_const == 0.0 or r_const == 0.0) {
+            return basic({ 0 });
+        }
+
+        if (l_const == 1.0) {
+            return rhs;
+        }
+
+        if (r_const == 1.0) {
+            return lhs;
+        }
+        break;
+      }
+      default: {
+        if (r_const == 1.0) {
+            return lhs;
+        }
+
+        if (l_const == 0.0) {
+            return basic({ 0 });
+        }
+        break;
+      }
+    }
+
+    if ((op == Operation::Add or op == Operation::Sub) and
+            (l_coeffs or r_coeffs)) {
+
+        if (auto res = merge(op, lhs, rhs)) {
+            return res;
+        }
+    }
+
+    auto key = std::make_tuple(op, lhs, rhs);
+    auto it = nodes_.find(key);
+    if (it != nodes_.end()) {
+        return it->second;
+    }
+
+    const TFunction* res = &ctx_.binary(op, *lhs, *rhs);
+    nodes_.emplace(key, res);
+
+    return res;
+}
+
+const TFunction* TSimplifier::merge(TFunction::Operation op,
+                                    const TFunction* lhs,
+                                    const TFunction* rhs)
+{
+    using Operation = TFunction::Operation;
+
+    // One operand is basic with coefficients q, the other one is the sum
+    // node = sign * g + p with a basic operand p.
+    bool node_is_lhs = getBasicCoeffs(*rhs) != nullptr;
+    const TFunction* node = node_is_lhs ? lhs : rhs;
+    const VectOfDouble& q = *getBasicCoeffs(node_is_lhs ? *rhs : *lhs);
+
+    if (node->op_ != Operation::Add and node->op_ != Operation::Sub) {
+        return nullptr;
+    }
+
+    auto l_coeffs = getBasicCoeffs(*node->lhs_);
+    auto r_coeffs = getBasicCoeffs(*node->rhs_);
+    if (not l_coeffs and not r_coeffs) {
+        return nullptr;
+    }
+
+    const TFunction* g = r_coeffs ? node->lhs_ : node->rhs_;
+    VectOfDouble p = r_coeffs ? *r_coeffs : *l_coeffs;
+    bool positive = true;
+
+    if (node->op_ == Operation::Sub) {
+        if (r_coeffs) {
+            p = vectSubtraction({}, p);
+        } else {
+            positive = false;
+        }
+    }
+
+    // Sum of the basic parts.
+    if (op == Operation::Add) {
+        p = vectAddition(p, q);
+
+    } else if (node_is_lhs) {
+        p = vectSubtraction(p, q);
+
+    } else {
+        p = vectSubtraction(q, p);
+        positive = not positive;
+    }
+
+    if (positive) {
+        return build(Operation::Add, g, basic(p));
+    }
+
+    return build(Operation::Sub, basic(p), g);
+}
+
+
+const TFunction& simplify(const TFunction& f, TExprContext& ctx)
+{
+    TSimplifier simplifier(ctx);
+
+    // Simplified nodes.
+    std::unordered_map<const TFunction*, const TFunction*> node_res;
+
+    // Post-order traversal with an explicit stack as in TTape.
+    std::vector<std::pair<const TFunction*, bool>> stack = { { &f, false } };
+    while (not stack.empty()) {
+        auto [node, expanded] = stack.back();
+        stack.pop_back();
+
+        if (node_res.count(node) != 0) {
+            continue;
+        }
+
+        const TFunction* res = node;
+
+        if (node->op_ != TFunction::Operation::None) {
+            if (not expanded) {
+                stack.push_back({ node, true });
+                stack.push_back({ node->rhs_, false });
+                stack.push_back({ node->lhs_, false });
+                continue;
+            }
+
+            res = simplifier.build(node->op_,
+                                   node_res.at(node->lhs_),
+                                   node_res.at(node->rhs_));
+
+        } else if (auto c_v = getBasicCoeffs(*node)) {
+            res = simplifier.basic(*c_v);
+        }
+
+        node_res[node] = res;
+    }
+
+    return *node_res.at(&f);
+}
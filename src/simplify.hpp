@@ -0,0 +1,24 @@
+#ifndef SIMPL_HEADER
+#define SIMPL_HEADER
+
+
+#include "functions.hpp"
+#include "arena.hpp"
+
+
+// Algebraic simplification of the function built by the arithmetic
+// operators or by TExprContext. The simplified graph is built in ctx and
+// evaluates the same function with fewer nodes:
+//     - operations with basic operands are folded into one coefficient
+//       vector, a sum of a basic function and a sum with a basic operand
+//       is regrouped to fold them too;
+//     - identities x + 0, x - 0, x * 1, x / 1 are removed;
+//     - 0 * f, 0 / f and f - f are replaced with zero;
+//     - equal subexpressions are shared.
+// The rules assume finite values, so a point where f is infinite or NaN may
+// give 0 instead of NaN. Functions which are neither basic nor composite are
+// referenced and must outlive ctx.
+const TFunction& simplify(const TFunction& f, TExprContext& ctx);
+
+
+#endif
@@ -0,0 +1,286 @@
+#include "solvecache.hpp"
+
+#include <unordered_map>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+// Maximum number of the slots probed by the lookup and the insertion.
+#define SOLVE_CACHE_MAX_PROBES 32
+
+// Magic number "EQSCACHE" and the version of the layout of the file.
+#define SOLVE_CACHE_MAGIC 0x4548434153515145ull
+#define SOLVE_CACHE_VERSION 1
+
+
+// Tags of the nodes mixed into the hash.
+enum class THashTag : std::uint64_t
+{
+    Basic = 1,
+    Add,
+    Sub,
+    Mul,
+    Div
+};
+
+
+void mixHash(std::uint64_t& hash, std::uint64_t word)
+{
+    for (unsigned i = 0; i < 8; i++) {
+        hash ^= (word >> (8 * i)) & 0xff;
+        hash *= 1099511628211ull;
+    }
+}
+
+void mixHash(std::uint64_t& hash, double c)
+{
+    if (c == 0) {
+        c = 0;
+
+    } else if (std::isnan(c)) {
+        c = NAN;
+    }
+
+    std::uint64_t bits;
+    std::memcpy(&bits, &c, sizeof(bits));
+    mixHash(hash, bits);
+}
+
+
+std::optional<std::uint64_t> getFunctionHash(const TFunction& f)
+{
+    std::unordered_map<const TFunction*, std::uint64_t> node_hash;
+
+    // Post-order traversal with an explicit stack as in TTape.
+    std::vector<std::pair<const TFunction*, bool>> stack = { { &f, false } };
+    while (not stack.empty()) {
+        auto [node, expanded] = stack.back();
+        stack.pop_back();
+
+        if (node_hash.count(node) != 0) {
+            continue;
+        }
+
+        std::uint64_t hash = 14695981039346656037ull;
+
+        if (node->op_ != TFunction::Operation::None) {
+            if (not expanded) {
+                stack.push_back({ node, true });
+                stack.push_back({ node->rhs_, false });
+                stack.push_back({ node->lhs_, false });
+                continue;
+            }
+
+            std::uint64_t l = node_hash.at(node->lhs_);
+            std::uint64_t r = node_hash.at(node->rhs_);
+            THashTag tag;
+
+            switch (node->op_) {
+              case TFunction::Operation::Add: {
+                tag = THashTag::Add;
+                break;
+              }
+              case TFunction::Operation::Sub: {
+                tag = THashTag::Sub;
+                break;
+              }
+              case TFunction::Operation::Mul: {
+                tag = THashTag::Mul;
+                break;
+              }
+              default: {
+                tag = THashTag::Div;
+                break;
+              }
+            }
+
+            // The operands of the commutative operations are unordered.
+            if ((tag == THashTag::Add or tag == THashTag::Mul) and l > r) {
+                std::swap(l, r);
+            }
+
+            mixHash(hash, static_cast<std::uint64_t>(tag));
+            mixHash(hash, l);
+            mixHash(hash, r);
+
+        } else if (auto c_v = getBasicCoeffs(*node)) {
+            std::size_t size = c_v->size();
+            while (size > 0 and c_v->at(size - 1) == 0) {
+                size--;
+            }
+
+            mixHash(hash, static_cast<std::uint64_t>(THashTag::Basic));
+            mixHash(hash, static_cast<std::uint64_t>(size));
+            for (std::size_t i = 0; i < size; i++) {
+                mixHash(hash, c_v->at(i));
+            }
+
+        } else {
+            return {};
+        }
+
+        node_hash[node] = hash;
+    }
+
+    return node_hash.at(&f);
+}
+
+
+// Header of the file followed by the slots.
+struct TSolveCacheHeader
+{
+    std::uint64_t magic;
+    std::uint64_t version;
+    std::uint64_t capacity;
+    std::uint64_t reserved;
+};
+
+
+// Function to throw the error of the system call.
+[[noreturn]] static void throwSystemError(const std::string& path)
+{
+    throw std::runtime_error("Error: Solve cache " + path + ": " +
+                             std::strerror(errno));
+}
+
+
+TSolveCache::TSolveCache(const std::string& path, std::size_t capacity)
+{
+    fd_ = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0 and (errno == EACCES or errno == EROFS)) {
+        fd_ = open(path.c_str(), O_RDONLY);
+        read_only_ = true;
+    }
+
+    if (fd_ < 0) {
+        throwSystemError(path);
+    }
+
+    std::size_t cap = 1;
+    while (cap < capacity) {
+        cap *= 2;
+    }
+
+    // The first writer creates the header under the lock, so concurrent
+    // openings of a new file agree on the capacity.
+    TSolveCacheHeader header = {};
+    bool valid = true;
+
+    if (flock(fd_, read_only_ ? LOCK_SH : LOCK_EX) != 0) {
+        close(fd_);
+        throwSystemError(path);
+    }
+
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+        valid = false;
+
+    } else if (st.st_size == 0 and not read_only_) {
+        header = { SOLVE_CACHE_MAGIC, SOLVE_CACHE_VERSION, cap, 0 };
+        valid = ftruncate(fd_, sizeof(header) + cap * sizeof(TSlot)) == 0 and
+                pwrite(fd_, &header, sizeof(header), 0) == sizeof(header);
+
+    } else {
+        valid = pread(fd_, &header, sizeof(header), 0) == sizeof(header) and
+                header.magic == SOLVE_CACHE_MAGIC and
+                header.version == SOLVE_CACHE_VERSION and
+                header.capacity != 0 and
+                (header.capacity & (header.capacity - 1)) == 0 and
+                static_cast<std::uint64_t>(st.st_size) ==
+                        sizeof(header) + header.capacity * sizeof(TSlot);
+    }
+
+    flock(fd_, LOCK_UN);
+
+    if (not valid) {
+        close(fd_);
+        throw std::runtime_error("Error: Invalid solve cache " + path);
+    }
+
+    capacity_ = header.capacity;
+    size_ = sizeof(header) + capacity_ * sizeof(TSlot);
+    data_ = mmap(nullptr,
+                 size_,
+                 read_only_ ? PROT_READ : PROT_READ | PROT_WRITE,
+                 MAP_SHARED,
+                 fd_,
+                 0);
+
+    if (data_ == MAP_FAILED) {
+        close(fd_);
+        throwSystemError(path);
+    }
+
+    slots_ = reinterpret_cast<TSlot*>(static_cast<char*>(data_) +
+                                      sizeof(header));
+}
+
+TSolveCache::~TSolveCache()
+{
+    munmap(data_, size_);
+    close(fd_);
+}
+
+
+std::optional<TCachedRoot> TSolveCache::find(std::uint64_t key) const
+{
+    // Zero marks the empty slots.
+    key = key != 0 ? key : 1;
+
+    for (std::size_t i = 0; i < SOLVE_CACHE_MAX_PROBES; i++) {
+        const TSlot& slot = slots_[(key + i) & (capacity_ - 1)];
+        std::uint64_t slot_key = slot.key.load(std::memory_order_acquire);
+
+        if (slot_key == 0) {
+            return {};
+        }
+
+        if (slot_key == key) {
+            return TCachedRoot { slot.root, slot.val };
+        }
+    }
+
+    return {};
+}
+
+void TSolveCache::insert(std::uint64_t key, const TCachedRoot& entry)
+{
+    if (read_only_) {
+        return;
+    }
+
+    key = key != 0 ? key : 1;
+
+    // The lock of the file is shared by the threads of the process, so they
+    // are serialized by the mutex.
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    if (flock(fd_, LOCK_EX) != 0) {
+        return;
+    }
+
+    for (std::size_t i = 0; i < SOLVE_CACHE_MAX_PROBES; i++) {
+        TSlot& slot = slots_[(key + i) & (capacity_ - 1)];
+        std::uint64_t slot_key = slot.key.load(std::memory_order_relaxed);
+
+        if (slot_key == key) {
+            break;
+        }
+
+        if (slot_key == 0) {
+            slot.root = entry.root;
+            slot.val = entry.val;
+            slot.key.store(key, std::memory_order_release);
+            break;
+        }
+    }
+
+    flock(fd_, LOCK_UN);
+}
@@ -0,0 +1,94 @@
+#ifndef SOLVECACHE_HEADER
+#define SOLVECACHE_HEADER
+
+
+#include "functions.hpp"
+
+#include <string>
+#include <optional>
+#include <atomic>
+#include <mutex>
+#include <cstddef>
+#include <cstdint>
+
+
+// Function to get the canonical structural hash of the function built from
+// the basic functions by the arithmetic operators. Equal coefficient vectors
+// give equal hashes regardless of the trailing zeros and the sign of zero,
+// and the operands of the sums and the products are unordered, so f + g and
+// g + f have the same hash. The hash does not depend on the addresses of the
+// nodes, so it is the same in every run. The result is empty if the function
+// has parts which are not basic and not composite.
+std::optional<std::uint64_t> getFunctionHash(const TFunction& f);
+
+// Functions to mix the word or the bits of the number into the 64-bit FNV-1a
+// hash, e.g. the settings of the solver into the hash of the function. All
+// zeros and all NaNs give the same bits.
+void mixHash(std::uint64_t& hash, std::uint64_t word);
+void mixHash(std::uint64_t& hash, double c);
+
+
+// Cached root of the equation.
+struct TCachedRoot
+{
+    double root;
+    double val;  // f(root) when the root was found.
+};
+
+
+// Persistent hash table of the roots in the memory-mapped file, so the
+// roots found by one run are reused by the next ones. The table has a fixed
+// number of slots and open addressing, an entry is never changed after it is
+// written. The key is written last with the release order, so the readers
+// of the same file in any thread or process never see partial entries and
+// never take locks. The writers are serialized by the mutex and by the lock
+// of the file. When the probed slots are occupied the new entry is dropped.
+class TSolveCache
+{
+public:
+    // Opens the file or creates it with capacity slots rounded up to a power
+    // of two. The capacity of the existing file is kept. A file which can
+    // not be written is opened for the lookups only. Throws
+    // std::runtime_error if the file can not be opened or is not a cache.
+    explicit TSolveCache(const std::string& path,
+                         std::size_t capacity = 1 << 16);
+    ~TSolveCache();
+
+    TSolveCache(const TSolveCache&) = delete;
+    TSolveCache& operator=(const TSolveCache&) = delete;
+
+    std::optional<TCachedRoot> find(std::uint64_t key) const;
+    void insert(std::uint64_t key, const TCachedRoot& entry);
+
+    std::size_t getCapacity() const
+    {
+        return capacity_;
+    }
+
+    bool isReadOnly() const
+    {
+        return read_only_;
+    }
+
+private:
+    struct TSlot
+    {
+        std::atomic<std::uint64_t> key;  // Zero in the empty slots.
+        double root;
+        double val;
+    };
+
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+                  "Slots in the shared memory need lock free atomics");
+
+    int fd_ = -1;
+    void* data_ = nullptr;
+    std::size_t size_ = 0;
+    TSlot* slots_ = nullptr;
+    std::size_t capacity_ = 0;
+    bool read_only_ = false;
+    std::mutex write_mutex_;
+};
+
+
+#endif
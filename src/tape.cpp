@@ -0,0 +1,407 @@
+#include "tape.hpp"
+
+#include <unordered_map>
+#include <limits>
+
+
+// Number of slots evaluated on the stack in the scalar interpreter. Larger
+// tapes keep their slots in a vector.
+#define TAPE_STACK_SLOTS 64
+
+
+TTape::TTape(const TFunction& f)
+{
+    // Index of the instruction computing the node.
+    std::unordered_map<const TFunction*, std::uint32_t> node_instr;
+
+    // Post-order traversal of the expression graph with an explicit stack,
+    // so long chains of operations do not overflow the call stack. The
+    // operands of the instructions are indices of instructions at first.
+    std::vector<std::pair<const TFunction*, bool>> stack = { { &f, false } };
+    while (not stack.empty()) {
+        auto [node, expanded] = stack.back();
+        stack.pop_back();
+
+        if (node_instr.count(node) != 0) {
+            continue;
+        }
+
+        TInstr instr = {};
+
+        if (node->op_ != TFunction::Operation::None) {
+            if (not expanded) {
+                stack.push_back({ node, true });
+                stack.push_back({ node->rhs_, false });
+                stack.push_back({ node->lhs_, false });
+                continue;
+            }
+
+            switch (node->op_) {
+              case TFunction::Operation::Add: {
+                instr.code = TOpCode::Add;
+                break;
+              }
+              case TFunction::Operation::Sub: {
+                instr.code = TOpCode::Sub;
+                break;
+              }
+              case TFunction::Operation::Mul: {
+                instr.code = TOpCode::Mul;
+                break;
+              }
+              default: {
+                instr.code = TOpCode::Div;
+                break;
+              }
+            }
+
+            instr.lhs = node_instr.at(node->lhs_);
+            instr.rhs = node_instr.at(node->rhs_);
+
+        } else if (auto c_v = getBasicCoeffs(*node)) {
+            instr.arg = coeffs_.size();
+
+            // Constants do not need the Horner loop.
+            if (c_v->size() <= 2 and (c_v->empty() or c_v->at(0) == 0)) {
+                instr.code = TOpCode::Const;
+                coeffs_.push_back(c_v->size() == 2 ? c_v->at(1) : 0);
+
+            } else {
+                instr.code = TOpCode::Poly;
+                instr.size = c_v->size();
+
+                // Basic functions are always IPolynomial.
+                instr.fast_exp =
+                        static_cast<const IPolynomial*>(node)->isFastExp();
+                coeffs_.insert(coeffs_.end(), c_v->begin(), c_v->end());
+            }
+
+        } else {
+            instr.code = TOpCode::Call;
+            instr.arg = calls_.size();
+            calls_.push_back(node);
+        }
+
+        node_instr[node] = instrs_.size();
+        instrs_.push_back(instr);
+    }
+
+    // Find the last instruction reading every value. The result is never
+    // released.
+    std::vector<std::size_t> last_use(instrs_.size(), 0);
+    for (std::size_t i = 0; i < instrs_.size(); i++) {
+        if (instrs_[i].code >= TOpCode::Add) {
+            last_use[instrs_[i].lhs] = i;
+            last_use[instrs_[i].rhs] = i;
+        }
+    }
+
+    last_use.back() = std::numeric_limits<std::size_t>::max();
+
+    // Assign the slots. A slot is released after the last read of its
+    // value and may be the destination of the same instruction.
+    std::vector<std::uint32_t> instr_slot(instrs_.size());
+    std::vector<std::uint32_t> free_slots;
+    for (std::size_t i = 0; i < instrs_.size(); i++) {
+        auto& instr = instrs_[i];
+
+        if (instr.code >= TOpCode::Add) {
+            std::uint32_t l = instr.lhs;
+            std::uint32_t r = instr.rhs;
+            instr.lhs = instr_slot[l];
+            instr.rhs = instr_slot[r];
+
+            if (last_use[l] == i) {
+                free_slots.push_back(instr_slot[l]);
+            }
+
+            if (last_use[r] == i and r != l) {
+                free_slots.push_back(instr_slot[r]);
+            }
+        }
+
+        if (free_slots.empty()) {
+            instr.dst = slots_num_++;
+
+        } else {
+            instr.dst = free_slots.back();
+            free_slots.pop_back();
+        }
+
+        instr_slot[i] = instr.dst;
+    }
+
+    result_slot_ = instrs_.back().dst;
+}
+
+
+template<class T>
+T TTape::run(double x, T* slots) const
+{
+    for (const auto& instr : instrs_) {
+        switch (instr.code) {
+          case TOpCode::Const: {
+            slots[instr.dst] = T(coeffs_[instr.arg]);
+            break;
+          }
+          case TOpCode::Poly: {
+            if constexpr (std::is_same_v<T, TDual>) {
+                slots[instr.dst] = polyValDeriv(&coeffs_[instr.arg],
+                                                instr.size,
+                                                x);
+            } else {
+                slots[instr.dst] = polyVal(&coeffs_[instr.arg],
+                                           instr.size,
+                                           x);
+            }
+            break;
+          }
+          case TOpCode::Call: {
+            if constexpr (std::is_same_v<T, TDual>) {
+                slots[instr.dst] = calls_[instr.arg]->get_val_deriv_ftor_(x);
+            } else {
+                slots[instr.dst] = calls_[instr.arg]->get_val_ftor_(x);
+            }
+            break;
+          }
+          case TOpCode::Add: {
+            slots[instr.dst] = slots[instr.lhs] + slots[instr.rhs];
+            break;
+          }
+          case TOpCode::Sub: {
+            slots[instr.dst] = slots[instr.lhs] - slots[instr.rhs];
+            break;
+          }
+          case TOpCode::Mul: {
+            slots[instr.dst] = slots[instr.lhs] * slots[instr.rhs];
+            break;
+          }
+          case TOpCode::Div: {
+            slots[instr.dst] = slots[instr.lhs] / slots[instr.rhs];
+            break;
+          }
+        }
+    }
+
+    return slots[result_slot_];
+}
+
+double TTape::operator()(double x) const
+{
+    if (slots_num_ <= TAPE_STACK_SLOTS) {
+        double slots[TAPE_STACK_SLOTS];
+        return run(x, slots);
+    }
+
+    VectOfDouble slots(slots_num_);
+    return run(x, slots.data());
+}
+
+TDual TTape::getValDeriv(double x) const
+{
+    if (slots_num_ <= TAPE_STACK_SLOTS) {
+        TDual slots[TAPE_STACK_SLOTS];
+        return run(x, slots);
+    }
+
+    std::vector<TDual> slots(slots_num_);
+    return run(x, slots.data());
+}
+
+double TTape::getDeriv(double x) const
+{
+    return getValDeriv(x).deriv;
+}
+
+
+void TTape::runBlock(const double* xs, double* val, std::size_t m) const
+{
+    for (const auto& instr : instrs_) {
+        double* dst = val + instr.dst * BATCH_BLOCK_SIZE;
+        const double* l = val + instr.lhs * BATCH_BLOCK_SIZE;
+        const double* r = val + instr.rhs * BATCH_BLOCK_SIZE;
+
+        switch (instr.code) {
+          case TOpCode::Const: {
+            std::fill(dst, dst + m, coeffs_[instr.arg]);
+            break;
+          }
+          case TOpCode::Poly: {
+            polyValBatch(&coeffs_[instr.arg],
+                         instr.size,
+                         xs,
+                         dst,
+                         m,
+                         instr.fast_exp);
+            break;
+          }
+          case TOpCode::Call: {
+            calls_[instr.arg]->get_val_batch_ftor_(xs, dst, m);
+            break;
+          }
+          case TOpCode::Add: {
+            #pragma omp simd
+            for (std::size_t j = 0; j < m; j++) {
+                dst[j] = l[j] + r[j];
+            }
+            break;
+          }
+          case TOpCode::Sub: {
+            #pragma omp simd
+            for (std::size_t j = 0; j < m; j++) {
+                dst[j] = l[j] - r[j];
+            }
+            break;
+          }
+          case TOpCode::Mul: {
+            #pragma omp simd
+            for (std::size_t j = 0; j < m; j++) {
+                dst[j] = l[j] * r[j];
+            }
+            break;
+          }
+          case TOpCode::Div: {
+            #pragma omp simd
+            for (std::size_t j = 0; j < m; j++) {
+                dst[j] = l[j] / r[j];
+            }
+            break;
+          }
+        }
+    }
+}
+
+void TTape::runBlock(const double* xs,
+                     double* val,
+                     double* deriv,
+                     std::size_t m) const
+{
+    for (const auto& instr : instrs_) {
+        double* dst = val + instr.dst * BATCH_BLOCK_SIZE;
+        double* dst_d = deriv + instr.dst * BATCH_BLOCK_SIZE;
+        const double* l = val + instr.lhs * BATCH_BLOCK_SIZE;
+        const double* l_d = deriv + instr.lhs * BATCH_BLOCK_SIZE;
+        const double* r = val + instr.rhs * BATCH_BLOCK_SIZE;
+        const double* r_d = deriv + instr.rhs * BATCH_BLOCK_SIZE;
+
+        // Binary instructions are applied to the dual numbers of the slots.
+        auto apply =
+        [&](auto op)
+        {
+            #pragma omp simd
+            for (std::size_t j = 0; j < m; j++) {
+                TDual res = op(TDual(l[j], l_d[j]), TDual(r[j], r_d[j]));
+                dst[j] = res.val;
+                dst_d[j] = res.deriv;
+            }
+        };
+
+        switch (instr.code) {
+          case TOpCode::Const: {
+            std::fill(dst, dst + m, coeffs_[instr.arg]);
+            std::fill(dst_d, dst_d + m, 0);
+            break;
+          }
+          case TOpCode::Poly: {
+            polyValDerivBatch(&coeffs_[instr.arg],
+                              instr.size,
+                              xs,
+                              dst,
+                              dst_d,
+                              m,
+                              instr.fast_exp);
+            break;
+          }
+          case TOpCode::Call: {
+            calls_[instr.arg]->get_val_deriv_batch_ftor_(xs, dst, dst_d, m);
+            break;
+          }
+          case TOpCode::Add: {
+            apply([](const TDual& a, const TDual& b) { return a + b; });
+            break;
+          }
+          case TOpCode::Sub: {
+            apply([](const TDual& a, const TDual& b) { return a - b; });
+            break;
+          }
+          case TOpCode::Mul: {
+            apply([](const TDual& a, const TDual& b) { return a * b; });
+            break;
+          }
+          case TOpCode::Div: {
+            apply([](const TDual& a, const TDual& b) { return a / b; });
+            break;
+          }
+        }
+    }
+}
+
+void TTape::evaluate(const double* xs, double* out, std::size_t n) const
+{
+    VectOfDouble val(slots_num_ * BATCH_BLOCK_SIZE);
+
+    for (std::size_t b = 0; b < n; b += BATCH_BLOCK_SIZE) {
+        std::size_t m = std::min(BATCH_BLOCK_SIZE, n - b);
+        runBlock(xs + b, val.data(), m);
+
+        const double* res = val.data() + result_slot_ * BATCH_BLOCK_SIZE;
+        std::copy(res, res + m, out + b);
+    }
+}
+
+void TTape::evaluateValDeriv(const double* xs,
+                             double* val_out,
+                             double* deriv_out,
+                             std::size_t n) const
+{
+    VectOfDouble val(slots_num_ * BATCH_BLOCK_SIZE);
+    VectOfDouble deriv(slots_num_ * BATCH_BLOCK_SIZE);
+
+    for (std::size_t b = 0; b < n; b += BATCH_BLOCK_SIZE) {
+        std::size_t m = std::min(BATCH_BLOCK_SIZE, n - b);
+        runBlock(xs + b, val.data(), deriv.data(), m);
+
+        std::size_t offset = result_slot_ * BATCH_BLOCK_SIZE;
+        std::copy(val.data() + offset, val.data() + offset + m, val_out + b);
+        std::copy(deriv.data() + offset,
+                  deriv.data() + offset + m,
+                  deriv_out + b);
+    }
+}
+
+
+std::unique_ptr<TFunction> TTape::toFunction() const
+{
+    auto tape = std::make_shared<const TTape>(*this);
+
+    auto res = std::make_unique<IPolynomial>(
+    [tape](double x)
+    {
+        return (*tape)(x);
+    },
+    [tape](double x)
+    {
+        return tape->getDeriv(x);
+    },
+    [tape](double x)
+    {
+        return tape->getValDeriv(x);
+    });
+
+    res->get_val_batch_ftor_ =
+    [tape](const double* xs, double* out, std::size_t n)
+    {
+        tape->evaluate(xs, out, n);
+    };
+
+    res->get_val_deriv_batch_ftor_ =
+    [tape](const double* xs,
+           double* val_out,
+           double* deriv_out,
+           std::size_t n)
+    {
+        tape->evaluateValDeriv(xs, val_out, deriv_out, n);
+    };
+
+    return res;
+}
@@ -0,0 +1,101 @@
+#ifndef TAPE_HEADER
+#define TAPE_HEADER
+
+
+#include "functions.hpp"
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+
+// Flattened form of the function built by the arithmetic operators.
+// The expression graph is lowered to a contiguous sequence of SSA
+// instructions. Every instruction writes one slot and reads the slots of the
+// earlier instructions, so an operand shared by several nodes is evaluated
+// once. A slot is reused after the last read of its value, so the number of
+// slots grows with the depth of the expression, not with its size.
+class TTape
+{
+public:
+    enum class TOpCode : std::uint8_t
+    {
+        Const,  // Constant coeffs_[arg].
+        Poly,   // Basic function with size coefficients from coeffs_[arg].
+        Call,   // Function calls_[arg] which is not built by the operators.
+        Add,
+        Sub,
+        Mul,
+        Div
+    };
+
+    struct TInstr
+    {
+        TOpCode code;
+        bool fast_exp;  // Poly uses fastExp() in the batch mode.
+        std::uint32_t dst;
+        std::uint32_t lhs;
+        std::uint32_t rhs;
+        std::uint32_t arg;
+        std::uint32_t size;
+    };
+
+    // Compile the tape. Functions which are not composite and not basic are
+    // called through their functors and must outlive the tape.
+    explicit TTape(const TFunction& f);
+
+    double operator()(double x) const;
+    double getDeriv(double x) const;
+    TDual getValDeriv(double x) const;
+
+    // Batch methods with the same meaning as in TFunction.
+    void evaluate(const double* xs, double* out, std::size_t n) const;
+    void evaluateValDeriv(const double* xs,
+                          double* val_out,
+                          double* deriv_out,
+                          std::size_t n) const;
+
+    // Method to get the type erased function which evaluates the tape.
+    std::unique_ptr<TFunction> toFunction() const;
+
+    const std::vector<TInstr>& getInstrs() const
+    {
+        return instrs_;
+    }
+
+    std::size_t getSlotsNum() const
+    {
+        return slots_num_;
+    }
+
+    std::size_t getResultSlot() const
+    {
+        return result_slot_;
+    }
+
+    const VectOfDouble& getCoeffs() const
+    {
+        return coeffs_;
+    }
+
+private:
+    std::vector<TInstr> instrs_;
+    VectOfDouble coeffs_;
+    std::vector<const TFunction*> calls_;
+    std::size_t slots_num_ = 0;
+    std::uint32_t result_slot_ = 0;
+
+    // Interpreter loops over the instructions for one point.
+    template<class T>
+    T run(double x, T* slots) const;
+
+    // Interpreter loops over the instructions for one block of points.
+    void runBlock(const double* xs, double* val, std::size_t m) const;
+    void runBlock(const double* xs,
+                  double* val,
+                  double* deriv,
+                  std::size_t m) const;
+};
+
+
+#endif
@@ -1,11 +1,27 @@
 #include "functions.hpp"
 #include "factory.hpp"
+#include "expression.hpp"
+#include "tape.hpp"
+#include "jit.hpp"
+#include "arena.hpp"
+#include "simplify.hpp"
+#include "polyroots.hpp"
+#include "batchsolver.hpp"
+#include "interval.hpp"
+#include "memo.hpp"
 #include "eqsolution.hpp"
 
 #include <gtest/gtest.h>
 
 #include <cstdlib>
+#include <cstring>
+#include <cstdint>
 #include <ctime>
+#include <filesystem>
+#include <random>
+#include <thread>
+
+#include <unistd.h>
 
 
 #define ITER_NUM 10
@@ -425,6 +441,42 @@ TEST(TestPoly, Deriv)
     }
 }
 
+TEST(TestPoly, ValDeriv)
+{
+    TFactory func_factory;
+
+    for (unsigned i = 0; i < ITER_NUM; i++) {
+        auto rand_coeffs = genPolyCoeffs();
+        auto f = func_factory.createObject("polynomial", rand_coeffs);
+        double rand_x = std::rand() % MAXRAND;
+
+        if (i >= ITER_NUM / 2) {
+            rand_x = -rand_x;
+        }
+
+        auto [val, deriv] = f->getValDeriv(rand_x);
+
+        ASSERT_DOUBLE_EQ(getPolyVal(rand_coeffs, rand_x), val);
+        ASSERT_DOUBLE_EQ(getPolyDeriv(rand_coeffs, rand_x), deriv);
+    }
+}
+
+TEST(TestPoly, Copy)
+{
+    TFactory func_factory;
+    auto rand_coeffs = genPolyCoeffs();
+    double rand_x = std::rand() % MAXRAND;
+
+    IPolynomial g;
+    {
+        auto f = func_factory.createObject("polynomial", rand_coeffs);
+        g = *f;
+    }
+
+    ASSERT_DOUBLE_EQ(getPolyVal(rand_coeffs, rand_x), g(rand_x));
+    ASSERT_DOUBLE_EQ(getPolyDeriv(rand_coeffs, rand_x), g.getDeriv(rand_x));
+}
+
 TEST(TestPoly, EqSolv)
 {
     TFactory func_factory;
@@ -1662,3 +1714,2060 @@ TEST(TestDiv, Deriv)
                          f55->getDeriv(rand_x));
     }
 }
+
+
+// Coefficient level algebra tests.
+TEST(TestAlgebra, Folding)
+{
+    TFactory func_factory;
+    auto f1 = func_factory.createObject("ident");
+    auto f2 = func_factory.createObject("const", 3);
+    auto f3 = func_factory.createObject("power", 2);
+    auto f4 = func_factory.createObject("exp");
+
+    auto f13 = (*f1) + (*f3);
+    auto f24 = (*f4) * (*f2);
+    auto f = (*f13) - (*f24);
+    auto g = (*f) * (*f1);
+    auto h = (*f4) * (*f1);
+
+    // The results are basic functions with merged coefficients.
+    ASSERT_STREQ("f(x) = -3*exp(x) + x + x^2", f->toString().c_str());
+    ASSERT_EQ(nullptr, getBasicCoeffs(*g));
+    ASSERT_EQ(nullptr, getBasicCoeffs(*h));
+
+    auto p = (*f13) * (*f13);
+    ASSERT_NE(nullptr, getBasicCoeffs(*p));
+    ASSERT_STREQ("f(x) = x^2 + 2*x^3 + x^4", p->toString().c_str());
+}
+
+TEST(TestAlgebra, Karatsuba)
+{
+    std::srand(static_cast<unsigned int>(time(0)));
+
+    for (unsigned size : { 33, 100, 257 }) {
+        VectOfDouble a(size);
+        VectOfDouble b(size / 2 + 40);
+        for (auto& c : a) {
+            c = std::rand() % MAXRAND - MAXRAND / 2;
+        }
+
+        for (auto& c : b) {
+            c = std::rand() % MAXRAND - MAXRAND / 2;
+        }
+
+        // Integer coefficients make both algorithms exact.
+        VectOfDouble expected(a.size() + b.size() - 1);
+        for (unsigned i = 0; i < a.size(); i++) {
+            for (unsigned j = 0; j < b.size(); j++) {
+                expected[i + j] += a[i] * b[j];
+            }
+        }
+
+        auto res = polyMultiplication(a, b);
+        ASSERT_EQ(expected.size(), res.size());
+        for (unsigned i = 0; i < res.size(); i++) {
+            ASSERT_DOUBLE_EQ(expected[i], res[i]);
+        }
+    }
+}
+
+
+// Dual number evaluation tests.
+TEST(TestDual, EvalOnce)
+{
+    unsigned val_calls = 0;
+    unsigned val_deriv_calls = 0;
+
+    // Function x^2 which counts its evaluations.
+    IPolynomial f(
+    [&val_calls](double x)
+    {
+        val_calls++;
+        return x * x;
+    },
+    [](double x)
+    {
+        return 2 * x;
+    },
+    [&val_deriv_calls](double x)
+    {
+        val_deriv_calls++;
+        return TDual(x * x, 2 * x);
+    });
+
+    // Nested quotients and products of the same operand.
+    auto g1 = f / f;
+    auto g2 = (*g1) * f;
+    auto g3 = (*g2) / (*g1);
+    auto g = (*g3) / f;
+
+    double x = 3;
+    double deriv = g->getDeriv(x);
+
+    // (x^2 / x^2) * x^2 / (x^2 / x^2) / x^2 = 1
+    ASSERT_DOUBLE_EQ(0, deriv);
+    ASSERT_EQ(0, val_calls);
+    ASSERT_EQ(6, val_deriv_calls);
+
+    TDual res = g->getValDeriv(x);
+    ASSERT_DOUBLE_EQ(1, res.val);
+    ASSERT_EQ(12, val_deriv_calls);
+}
+
+
+// Batch evaluation tests.
+TEST(TestBatch, Basic)
+{
+    TFactory func_factory;
+    auto rand_coeffs = genPolyCoeffs();
+    auto f = func_factory.createObject("polynomial", rand_coeffs);
+    auto g = func_factory.createObject("exp");
+
+    // More points than in one block to check the tail handling.
+    VectOfDouble xs(3 * BATCH_BLOCK_SIZE + 7);
+    for (unsigned i = 0; i < xs.size(); i++) {
+        xs[i] = -5 + 10.0 * i / xs.size();
+    }
+
+    VectOfDouble val(xs.size());
+    VectOfDouble deriv(xs.size());
+
+    f->evaluateValDeriv(xs.data(), val.data(), deriv.data(), xs.size());
+    for (unsigned i = 0; i < xs.size(); i++) {
+        ASSERT_DOUBLE_EQ((*f)(xs[i]), val[i]);
+        ASSERT_DOUBLE_EQ(f->getDeriv(xs[i]), deriv[i]);
+    }
+
+    g->evaluate(xs.data(), val.data(), xs.size());
+    g->evaluateDeriv(xs.data(), deriv.data(), xs.size());
+    for (unsigned i = 0; i < xs.size(); i++) {
+        ASSERT_DOUBLE_EQ(exp(xs[i]), val[i]);
+        ASSERT_DOUBLE_EQ(exp(xs[i]), deriv[i]);
+    }
+}
+
+TEST(TestBatch, Composite)
+{
+    TFactory func_factory;
+    auto rand_coeffs = genPolyCoeffs();
+
+    auto f1 = func_factory.createObject("ident");
+    auto f2 = func_factory.createObject("const", 3);
+    auto f4 = func_factory.createObject("exp");
+    auto f5 = func_factory.createObject("polynomial", rand_coeffs);
+
+    auto f14 = (*f1) * (*f4);
+    auto f52 = (*f5) - (*f2);
+    auto f = (*f14) / (*f52);
+    auto g = (*f) + (*f1);
+
+    VectOfDouble xs(2 * BATCH_BLOCK_SIZE + 3);
+    for (unsigned i = 0; i < xs.size(); i++) {
+        xs[i] = -3 + 6.0 * i / xs.size();
+    }
+
+    VectOfDouble val(xs.size());
+    VectOfDouble deriv(xs.size());
+
+    g->evaluate(xs.data(), val.data(), xs.size());
+    g->evaluateDeriv(xs.data(), deriv.data(), xs.size());
+    for (unsigned i = 0; i < xs.size(); i++) {
+        ASSERT_DOUBLE_EQ((*g)(xs[i]), val[i]);
+        ASSERT_DOUBLE_EQ(g->getDeriv(xs[i]), deriv[i]);
+    }
+}
+
+TEST(TestBatch, FastExp)
+{
+    // Distance in ULPs between two doubles of the same sign.
+    auto ulp_dist =
+    [](double a, double b)
+    {
+        std::int64_t a_bits;
+        std::int64_t b_bits;
+        std::memcpy(&a_bits, &a, sizeof(a));
+        std::memcpy(&b_bits, &b, sizeof(b));
+
+        return std::abs(a_bits - b_bits);
+    };
+
+    // The whole range from the underflow to zero to the overflow.
+    VectOfDouble xs(1000000);
+    for (unsigned i = 0; i < xs.size(); i++) {
+        xs[i] = -746 + 1456.0 * (i + sqrt(0.5)) / xs.size();
+    }
+
+    for (double x : xs) {
+        ASSERT_GE(1, ulp_dist(exp(x), fastExp(x))) << x;
+    }
+
+    // Small arguments and the bounds.
+    for (double x : { 0.0, -0.0, 1e-300, -1e-300, 1e-10, -1e-10, 0.5,
+                      -708.4, -708.3, -745.1, -745.2, 709.78, 709.79 }) {
+        ASSERT_GE(1, ulp_dist(exp(x), fastExp(x))) << x;
+    }
+
+    ASSERT_EQ(HUGE_VAL, fastExp(HUGE_VAL));
+    ASSERT_EQ(0, fastExp(-HUGE_VAL));
+    ASSERT_EQ(HUGE_VAL, fastExp(1e308));
+    ASSERT_EQ(0, fastExp(-1e308));
+    ASSERT_TRUE(std::isnan(fastExp(NAN)));
+
+    // The mode is selected per function.
+    auto f = std::make_unique<IPolynomial>(VectOfDouble({ 2, 1, 3 }));
+    f->setFastExp(true);
+    IPolynomial g = *f;
+    ASSERT_TRUE(g.isFastExp());
+
+    VectOfDouble val(xs.size());
+    VectOfDouble deriv(xs.size());
+    g.evaluateValDeriv(xs.data(), val.data(), deriv.data(), xs.size());
+
+    for (unsigned i = 0; i < xs.size(); i += 97) {
+        double e = 2 * fastExp(xs[i]);
+        ASSERT_DOUBLE_EQ(3 * xs[i] + 1 + e, val[i]);
+        ASSERT_DOUBLE_EQ(3 + e, deriv[i]);
+    }
+}
+
+
+// Expression template tests.
+TEST(TestExpr, Val)
+{
+    std::srand(static_cast<unsigned int>(time(0)));
+    double rand_const = std::rand() % MAXRAND;
+    double rand_exp = std::rand() % MAXRAND_EXP + 1;
+    auto rand_coeffs = genPolyCoeffs();
+
+    auto e1 = expr(TIdent()) * TExp() + TConst(rand_const);
+    auto e2 = (expr(TPower(rand_exp)) - TPolynomial(rand_coeffs)) / TExp();
+
+    for (unsigned i = 0; i < ITER_NUM; i++) {
+        double rand_x = std::rand() % MAXRAND_EXP;
+
+        ASSERT_DOUBLE_EQ(rand_x * exp(rand_x) + rand_const, e1(rand_x));
+        ASSERT_DOUBLE_EQ((pow(rand_x, rand_exp) -
+                          getPolyVal(rand_coeffs, rand_x)) / exp(rand_x),
+                         e2(rand_x));
+    }
+}
+
+TEST(TestExpr, Deriv)
+{
+    std::srand(static_cast<unsigned int>(time(0)));
+    double rand_const = std::rand() % MAXRAND;
+    auto rand_coeffs = genPolyCoeffs();
+
+    auto e1 = expr(TIdent()) * TExp() + TConst(rand_const);
+    auto e2 = expr(TPolynomial(rand_coeffs)) * TIdent() - TExp();
+
+    for (unsigned i = 0; i < ITER_NUM; i++) {
+        double rand_x = std::rand() % MAXRAND_EXP;
+
+        ASSERT_DOUBLE_EQ(getMulDeriv(1, exp(rand_x), rand_x, exp(rand_x)),
+                         e1.getDeriv(rand_x));
+        ASSERT_DOUBLE_EQ(getMulDeriv(getPolyDeriv(rand_coeffs, rand_x),
+                                     1,
+                                     getPolyVal(rand_coeffs, rand_x),
+                                     rand_x) - exp(rand_x),
+                         e2.getDeriv(rand_x));
+    }
+}
+
+TEST(TestExpr, TypeErasure)
+{
+    TFactory func_factory;
+    auto rand_coeffs = genPolyCoeffs();
+    auto g = func_factory.createObject("polynomial", rand_coeffs);
+
+    // The temporaries of the expression die before the function is used.
+    std::unique_ptr<TFunction> f = TIdent() * ref(*g) + TConst(2);
+
+    for (unsigned i = 0; i < ITER_NUM; i++) {
+        double rand_x = std::rand() % MAXRAND_EXP;
+
+        ASSERT_DOUBLE_EQ(rand_x * getPolyVal(rand_coeffs, rand_x) + 2,
+                         (*f)(rand_x));
+        ASSERT_DOUBLE_EQ(getMulDeriv(1, getPolyDeriv(rand_coeffs, rand_x),
+                                     rand_x, getPolyVal(rand_coeffs, rand_x)),
+                         f->getDeriv(rand_x));
+    }
+}
+
+TEST(TestExpr, BasicOperands)
+{
+    // Arithmetic on the basic functions alone is not an expression.
+    TIdent id;
+    TExp ex;
+    auto f = id + TConst(2);
+    auto g = id * ex;
+    static_assert(std::is_same_v<decltype(f), std::unique_ptr<TFunction>>);
+    static_assert(std::is_same_v<decltype(g), std::unique_ptr<TFunction>>);
+
+    auto e = expr(id) * ex;
+    static_assert(is_expr_v<decltype(e)>);
+
+    for (unsigned i = 0; i < ITER_NUM; i++) {
+        double rand_x = std::rand() % MAXRAND_EXP;
+
+        ASSERT_DOUBLE_EQ(rand_x + 2, (*f)(rand_x));
+        ASSERT_DOUBLE_EQ(rand_x * exp(rand_x), (*g)(rand_x));
+        ASSERT_DOUBLE_EQ((*g)(rand_x), e(rand_x));
+    }
+}
+
+
+// Expression tape tests.
+TEST(TestTape, Eval)
+{
+    TFactory func_factory;
+    auto rand_coeffs = genPolyCoeffs();
+
+    auto f1 = func_factory.createObject("ident");
+    auto f4 = func_factory.createObject("exp");
+    auto f5 = func_factory.createObject("polynomial", rand_coeffs);
+
+    IPolynomial f6(
+    [](double x)
+    {
+        return sin(x);
+    },
+    [](double x)
+    {
+        return cos(x);
+    });
+
+    auto f14 = (*f1) * (*f4);
+    auto f56 = (*f5) / f6;
+    auto f = (*f14) - (*f56);
+    auto g = (*f) * (*f14);
+
+    TTape tape(*g);
+    auto h = tape.toFunction();
+
+    VectOfDouble xs(BATCH_BLOCK_SIZE + 11);
+    for (unsigned i = 0; i < xs.size(); i++) {
+        xs[i] = 0.1 + 3.0 * i / xs.size();
+    }
+
+    VectOfDouble val(xs.size());
+    VectOfDouble deriv(xs.size());
+    h->evaluateValDeriv(xs.data(), val.data(), deriv.data(), xs.size());
+
+    for (unsigned i = 0; i < xs.size(); i++) {
+        ASSERT_DOUBLE_EQ((*g)(xs[i]), tape(xs[i]));
+        ASSERT_DOUBLE_EQ(g->getDeriv(xs[i]), tape.getDeriv(xs[i]));
+        ASSERT_DOUBLE_EQ((*g)(xs[i]), val[i]);
+        ASSERT_DOUBLE_EQ(g->getDeriv(xs[i]), deriv[i]);
+    }
+}
+
+TEST(TestTape, Structure)
+{
+    TFactory func_factory;
+    auto f1 = func_factory.createObject("ident");
+    auto f4 = func_factory.createObject("exp");
+
+    // x*exp(x) is shared by both operands of the sum.
+    auto f14 = (*f1) * (*f4);
+    auto f = (*f14) + (*f14);
+
+    TTape tape(*f);
+    ASSERT_EQ(4, tape.getInstrs().size());
+
+    // Long chain of sums needs few slots.
+    std::vector<std::unique_ptr<TFunction>> chain;
+    chain.push_back((*f14) * (*f4));
+    for (unsigned i = 0; i < 1000; i++) {
+        chain.push_back((*chain.back()) + (*f14));
+    }
+
+    TTape chain_tape(*chain.back());
+    ASSERT_EQ(1004, chain_tape.getInstrs().size());
+    ASSERT_GE(4, chain_tape.getSlotsNum());
+    ASSERT_DOUBLE_EQ((*chain.back())(0.5), chain_tape(0.5));
+}
+
+
+// Native compilation tests.
+TEST(TestJit, Compile)
+{
+    TFactory func_factory;
+    auto rand_coeffs = genPolyCoeffs();
+
+    auto f1 = func_factory.createObject("ident");
+    auto f2 = func_factory.createObject("const", 2);
+    auto f4 = func_factory.createObject("exp");
+    auto f5 = func_factory.createObject("polynomial", rand_coeffs);
+
+    auto f14 = (*f1) * (*f4);
+    auto f45 = (*f4) / (*f5);
+    auto f = (*f14) - (*f45);
+    auto g = (*f) * (*f2);
+
+    std::string cache_dir = (std::filesystem::temp_directory_path() /
+                             ("eqsolver-jit-test-" +
+                              std::to_string(getpid()))).string();
+    TJit jit(cache_dir);
+
+    ASSERT_FALSE(std::filesystem::exists(jit.getObjectPath(*g)));
+    auto h = jit.compile(*g);
+    ASSERT_TRUE(std::filesystem::exists(jit.getObjectPath(*g)));
+
+    // The second compilation takes the cached object.
+    auto h2 = jit.compile(*g);
+
+    VectOfDouble xs(100);
+    for (unsigned i = 0; i < xs.size(); i++) {
+        xs[i] = 0.1 + 5.0 * i / xs.size();
+    }
+
+    VectOfDouble val(xs.size());
+    VectOfDouble deriv(xs.size());
+    h2->evaluateValDeriv(xs.data(), val.data(), deriv.data(), xs.size());
+
+    // The object may be built for another target than the test, e.g.
+    // without the fused multiply-add, so the terms are rounded differently
+    // and the tolerances follow their magnitudes.
+    for (unsigned i = 0; i < xs.size(); i++) {
+        double x = xs[i];
+        double p = (*f5)(x);
+        double q = std::abs(exp(x) / p);
+        double val_scale = 2 * (std::abs((*f14)(x)) + q);
+        double deriv_scale = 2 * (std::abs(f14->getDeriv(x)) +
+                                  q * (1 + std::abs(f5->getDeriv(x) / p)));
+
+        ASSERT_NEAR((*g)(x), (*h)(x), 1e-12 * val_scale);
+        ASSERT_NEAR(g->getDeriv(x), h->getDeriv(x), 1e-12 * deriv_scale);
+        ASSERT_DOUBLE_EQ((*h)(x), val[i]);
+        ASSERT_DOUBLE_EQ(h->getDeriv(x), deriv[i]);
+    }
+
+    std::filesystem::remove_all(cache_dir);
+}
+
+TEST(TestJit, CacheDir)
+{
+    TFactory func_factory;
+    auto f1 = func_factory.createObject("ident");
+    auto f4 = func_factory.createObject("exp");
+    auto f = (*f1) * (*f4);
+
+    // The path is not parsed by the shell.
+    std::filesystem::path base = std::filesystem::temp_directory_path() /
+                                 ("eqsolver jit;$(false)-" +
+                                  std::to_string(getpid()));
+    std::string cache_dir = (base / "cache").string();
+    TJit jit(cache_dir);
+
+    // Threads compiling the same function use different temporary files.
+    std::vector<std::unique_ptr<TFunction>> res(4);
+    std::vector<std::thread> threads;
+    for (auto& h : res) {
+        threads.emplace_back([&jit, &f, &h]()
+        {
+            h = jit.compile(*f);
+        });
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    for (const auto& h : res) {
+        ASSERT_DOUBLE_EQ((*f)(1.5), (*h)(1.5));
+    }
+
+    auto perms = std::filesystem::status(cache_dir).permissions();
+    ASSERT_EQ(std::filesystem::perms::owner_all, perms);
+
+    // The directory writable by others is never used.
+    std::filesystem::permissions(cache_dir,
+                                 std::filesystem::perms::others_write,
+                                 std::filesystem::perm_options::add);
+    ASSERT_THROW(jit.compile(*f), std::runtime_error);
+
+    std::filesystem::remove_all(base);
+}
+
+TEST(TestJit, Opaque)
+{
+    TFactory func_factory;
+    auto f1 = func_factory.createObject("ident");
+
+    IPolynomial f2(
+    [](double x)
+    {
+        return sin(x);
+    },
+    [](double x)
+    {
+        return cos(x);
+    });
+
+    auto f = (*f1) + f2;
+
+    ASSERT_THROW(TJit().compile(*f), std::logic_error);
+}
+
+
+// Expression context tests.
+TEST(TestArena, Eval)
+{
+    TFactory func_factory;
+    auto rand_coeffs = genPolyCoeffs();
+
+    auto f1 = func_factory.createObject("ident");
+    auto f4 = func_factory.createObject("exp");
+    auto f5 = func_factory.createObject("polynomial", rand_coeffs);
+
+    auto f14 = (*f1) * (*f4);
+    auto f45 = (*f4) / (*f5);
+    auto g = (*f14) - (*f45);
+
+    TExprContext ctx;
+    const auto& x = ctx.ident();
+    const auto& e = ctx.exp();
+    const auto& h = ctx.sub(ctx.mul(x, e),
+                            ctx.div(e, ctx.polynomial(rand_coeffs)));
+
+    ASSERT_EQ(6, ctx.getNodesNum());
+    ASSERT_EQ(&x, &ctx.ident());
+
+    VectOfDouble xs(BATCH_BLOCK_SIZE + 11);
+    for (unsigned i = 0; i < xs.size(); i++) {
+        xs[i] = 0.1 + 3.0 * i / xs.size();
+    }
+
+    VectOfDouble val(xs.size());
+    VectOfDouble deriv(xs.size());
+    h.evaluateValDeriv(xs.data(), val.data(), deriv.data(), xs.size());
+
+    for (unsigned i = 0; i < xs.size(); i++) {
+        ASSERT_DOUBLE_EQ((*g)(xs[i]), h(xs[i]));
+        ASSERT_DOUBLE_EQ(g->getDeriv(xs[i]), h.getDeriv(xs[i]));
+        ASSERT_DOUBLE_EQ((*g)(xs[i]), val[i]);
+        ASSERT_DOUBLE_EQ(g->getDeriv(xs[i]), deriv[i]);
+    }
+
+    // Nodes of the context are compiled to the tape as composite functions.
+    TTape tape(h);
+    ASSERT_EQ(6, tape.getInstrs().size());
+    ASSERT_DOUBLE_EQ(h(0.5), tape(0.5));
+}
+
+TEST(TestArena, Lifetime)
+{
+    TExprContext ctx(2000);
+    const TFunction* f = nullptr;
+
+    {
+        TFactory func_factory;
+        auto f1 = func_factory.createObject("ident");
+        auto f4 = func_factory.createObject("exp");
+
+        // Copy of the composite function does not depend on its operands.
+        auto f14 = (*f1) * (*f4);
+        auto g = (*f14) + (*f14);
+        f = &ctx.copy(*g);
+
+        ASSERT_DOUBLE_EQ((*g)(0.7), (*f)(0.7));
+    }
+
+    ASSERT_DOUBLE_EQ(2 * 0.7 * exp(0.7), (*f)(0.7));
+    ASSERT_DOUBLE_EQ(2 * 1.7 * exp(0.7), f->getDeriv(0.7));
+
+    // Long chain of nodes.
+    const TFunction* chain = &ctx.mul(ctx.ident(), ctx.exp());
+    for (unsigned i = 0; i < 1000; i++) {
+        chain = &ctx.add(*chain, ctx.constant(1));
+    }
+
+    ASSERT_DOUBLE_EQ(0.5 * exp(0.5) + 1000, (*chain)(0.5));
+
+    // The context works with the solver.
+    auto eq_root = EqSolver().solveEquation(ctx.sub(ctx.power(2),
+                                                    ctx.constant(4)));
+
+    ASSERT_TRUE(eq_root.has_value());
+    ASSERT_NEAR(0, eq_root.value() * eq_root.value() - 4, 0.01);
+}
+
+
+// Simplification tests.
+TEST(TestSimplify, Identities)
+{
+    TFactory func_factory;
+    auto f0 = func_factory.createObject("const", 0);
+    auto f1 = func_factory.createObject("ident");
+    auto f2 = func_factory.createObject("const", 1);
+    auto f4 = func_factory.createObject("exp");
+
+    IPolynomial f6(
+    [](double x)
+    {
+        return sin(x);
+    },
+    [](double x)
+    {
+        return cos(x);
+    });
+
+    // 0*f + x*1 is x.
+    auto f46 = (*f4) / f6;
+    auto f046 = (*f0) * (*f46);
+    auto f12 = (*f1) * (*f2);
+    auto f = (*f046) + (*f12);
+
+    TExprContext ctx;
+    const auto& g = simplify(*f, ctx);
+    ASSERT_NE(nullptr, getBasicCoeffs(g));
+    ASSERT_EQ(VectOfDouble({ 0, 0, 1 }), *getBasicCoeffs(g));
+
+    // (f - f) / 1 + x is x, equal subexpressions are found by structure.
+    auto f14 = (*f1) * (*f4);
+    auto f14_copy = (*f1) * (*f4);
+    auto f_f = (*f14) - (*f14_copy);
+    auto f_f2 = (*f_f) / (*f2);
+    auto h = (*f_f2) + (*f1);
+
+    const auto& k = simplify(*h, ctx);
+    ASSERT_NE(nullptr, getBasicCoeffs(k));
+    ASSERT_EQ(VectOfDouble({ 0, 0, 1 }), *getBasicCoeffs(k));
+}
+
+TEST(TestSimplify, Merge)
+{
+    TFactory func_factory;
+    auto rand_coeffs = genPolyCoeffs();
+
+    auto f1 = func_factory.createObject("ident");
+    auto f2 = func_factory.createObject("const", 2);
+    auto f3 = func_factory.createObject("power", 2);
+    auto f5 = func_factory.createObject("polynomial", rand_coeffs);
+
+    IPolynomial f6(
+    [](double x)
+    {
+        return sin(x);
+    },
+    [](double x)
+    {
+        return cos(x);
+    });
+
+    // ((sin(x) + x) + 2) - (x^2 - P(x)) is sin(x) plus one polynomial.
+    auto f61 = f6 + (*f1);
+    auto f612 = (*f61) + (*f2);
+    auto f35 = (*f3) - (*f5);
+    auto f2_61 = (*f2) - (*f61);
+    auto f = (*f612) - (*f35);
+    auto g = (*f) * (*f2_61);
+
+    TExprContext ctx;
+    const auto& h = simplify(*g, ctx);
+
+    // Call, two polynomials, the sum, the difference and the product.
+    TTape tape(h);
+    ASSERT_EQ(6, tape.getInstrs().size());
+
+    for (unsigned i = 0; i < 100; i++) {
+        double x = -3.0 + 6.0 * i / 100;
+        ASSERT_NEAR((*g)(x), h(x), 1e-9 * (1 + std::abs((*g)(x))));
+        ASSERT_NEAR(g->getDeriv(x),
+                    h.getDeriv(x),
+                    1e-9 * (1 + std::abs(g->getDeriv(x))));
+    }
+}
+
+
+// Newton-Raphson solver tests.
+TEST(TestNewton, EqSolv)
+{
+    TFactory func_factory;
+    std::srand(static_cast<unsigned int>(time(0)));
+
+    EqSolver solver(1000, 1, EPS, EqSolver::Method::Newton);
+
+    for (unsigned i = 0; i < ITER_NUM; i++) {
+        double rand_exp = std::rand() % MAXRAND_EXP + 1;
+        auto f = func_factory.createObject("power", rand_exp);
+
+        auto eq_root = solver.solveEquation(*f);
+
+        // Newton iterations converge linearly to the multiple root, the
+        // last step is rand_exp times less than the error.
+        ASSERT_TRUE(eq_root.has_value());
+        ASSERT_NEAR(0, eq_root.value(), rand_exp * EPS);
+
+        // (x - r1)(x - r2) with the roots of different signs.
+        double r1 = std::rand() % MAXRAND + 0.5;
+        double r2 = -(std::rand() % MAXRAND) - 0.5;
+        auto g = func_factory.createObject("polynomial",
+                                           VectOfDouble({ r1 * r2,
+                                                          -(r1 + r2),
+                                                          1 }));
+
+        eq_root = solver.solveEquation(*g);
+
+        ASSERT_TRUE(eq_root.has_value());
+        ASSERT_GT(EPS, std::abs((*g)(eq_root.value())));
+    }
+}
+
+TEST(TestNewton, Safeguards)
+{
+    TFactory func_factory;
+
+    // The derivative is zero at the initial point.
+    auto f = func_factory.createObject("polynomial", VectOfDouble({ -4, 0, 1 }));
+    auto eq_root = EqSolver(1000, 0, EPS, EqSolver::Method::Newton)
+            .solveEquation(*f);
+
+    ASSERT_TRUE(eq_root.has_value());
+    ASSERT_NEAR(2, std::abs(eq_root.value()), EPS);
+
+    // Pure Newton iterations cycle between 0 and 1 for x^3 - 2x + 2.
+    auto g = func_factory.createObject("polynomial",
+                                       VectOfDouble({ 2, -2, 0, 1 }));
+    eq_root = EqSolver(1000, -1, EPS, EqSolver::Method::Newton)
+            .solveEquation(*g);
+
+    ASSERT_TRUE(eq_root.has_value());
+    ASSERT_GT(EPS, std::abs((*g)(eq_root.value())));
+
+    // No root.
+    auto h = func_factory.createObject("exp");
+    eq_root = EqSolver(100, 1, 0.000001, EqSolver::Method::Newton)
+            .solveEquation(*h);
+
+    ASSERT_FALSE(eq_root.has_value());
+
+    // Newton iterations need much fewer evaluations than gradient descent.
+    unsigned evals_num = 0;
+    IPolynomial k(
+    [&evals_num](double x)
+    {
+        evals_num++;
+        return exp(x) - 10;
+    },
+    [&evals_num](double x)
+    {
+        evals_num++;
+        return exp(x);
+    },
+    [&evals_num](double x)
+    {
+        evals_num++;
+        return TDual(exp(x) - 10, exp(x));
+    });
+
+    eq_root = EqSolver().solveEquation(k);
+    ASSERT_TRUE(eq_root.has_value());
+    unsigned gr_evals_num = evals_num;
+
+    evals_num = 0;
+    eq_root = EqSolver(1000, 1, 0.001, EqSolver::Method::Newton)
+            .solveEquation(k);
+
+    ASSERT_TRUE(eq_root.has_value());
+    ASSERT_NEAR(log(10), eq_root.value(), EPS);
+    ASSERT_GT(gr_evals_num, 100 * evals_num);
+}
+
+TEST(TestNewton, NearRoot)
+{
+    TFactory func_factory;
+
+    // x^3 + 5x^2 - 7x - 3 at the point next to the root, where |f| is at the
+    // level of the rounding errors and can not be decreased any more.
+    auto f = func_factory.createObject("polynomial",
+                                       VectOfDouble({ -3, -7, 5, 1 }));
+    double x = 1.4196007701720537;
+    ASSERT_GT(1e-14, std::abs((*f)(x)));
+
+    auto res = EqSolver(1000, 1, EPS, EqSolver::Method::Newton)
+            .solveWithStats(*f, x);
+
+    ASSERT_TRUE(res.root.has_value());
+    ASSERT_NEAR(x, res.root.value(), 1e-12);
+}
+
+TEST(TestNewton, Stationary)
+{
+    // The derivative at the initial point 1 is zero up to the rounding
+    // errors and |f| has the local minimum there, so neither the Newton
+    // step nor the steepest descent decreases it.
+    IPolynomial f(VectOfDouble({ 0, -7, -7.2, 0.9, 9.8, -5.5, -0.4 }));
+    ASSERT_GT(1e-12, std::abs(f.getDeriv(1)));
+
+    auto eq_root = EqSolver(1000, 1, EPS, EqSolver::Method::Newton)
+            .solveEquation(f);
+
+    ASSERT_TRUE(eq_root.has_value());
+    ASSERT_GT(EPS, std::abs(f(eq_root.value())));
+
+    // x^2 + 1 has the minimum of |f| without the root.
+    IPolynomial g(VectOfDouble({ 0, 1, 0, 1 }));
+    ASSERT_FALSE(EqSolver(1000, 0, EPS, EqSolver::Method::Newton)
+            .solveEquation(g).has_value());
+}
+
+
+// Brent's method tests.
+TEST(TestBrent, EqSolv)
+{
+    TFactory func_factory;
+    std::srand(static_cast<unsigned int>(time(0)));
+
+    for (unsigned i = 0; i < ITER_NUM; i++) {
+        // (x - r1)(x - r2) with one root on [0, MAXRAND].
+        double r1 = std::rand() % MAXRAND + 0.5;
+        double r2 = -(std::rand() % MAXRAND) - 0.5;
+        auto f = func_factory.createObject("polynomial",
+                                           VectOfDouble({ r1 * r2,
+                                                          -(r1 + r2),
+                                                          1 }));
+
+        auto res = EqSolver().solveBracketed(*f, 0, MAXRAND);
+
+        ASSERT_TRUE(res.root.has_value());
+        ASSERT_NEAR(r1, res.root.value(), EPS);
+        ASSERT_GT(50, res.evals_num);
+    }
+
+    // Roots at the ends.
+    auto g = func_factory.createObject("ident");
+    auto res = EqSolver().solveBracketed(*g, 0, 1);
+
+    ASSERT_TRUE(res.root.has_value());
+    ASSERT_EQ(0, res.root.value());
+    ASSERT_EQ(2, res.evals_num);
+}
+
+TEST(TestBrent, Bracket)
+{
+    TFactory func_factory;
+    auto f = func_factory.createObject("exp");
+
+    // No change of sign.
+    auto res = EqSolver().solveBracketed(*f, -1, 1);
+    ASSERT_FALSE(res.root.has_value());
+    ASSERT_EQ(2, res.evals_num);
+    ASSERT_FALSE(EqSolver().solveEquation(*f, -1, 1).has_value());
+
+    // exp(x) - 10 needs few evaluations, every one is counted.
+    unsigned evals_num = 0;
+    IPolynomial g(
+    [&evals_num](double x)
+    {
+        evals_num++;
+        return exp(x) - 10;
+    },
+    [](double x)
+    {
+        return exp(x);
+    });
+
+    res = EqSolver(1000, 1, 1e-9).solveBracketed(g, -10, 10);
+
+    ASSERT_TRUE(res.root.has_value());
+    ASSERT_NEAR(log(10), res.root.value(), 1e-9);
+    ASSERT_EQ(evals_num, res.evals_num);
+    ASSERT_GT(30, res.evals_num);
+
+    auto eq_root = EqSolver(1000, 1, 1e-9).solveEquation(g, -10, 10);
+    ASSERT_EQ(res.root, eq_root);
+
+    // Step function changes the sign without a root, the result is the
+    // point of the jump.
+    IPolynomial h(
+    [](double x)
+    {
+        return x < 0.3 ? -1.0 : 1.0;
+    },
+    [](double x)
+    {
+        return 0.0;
+    });
+
+    res = EqSolver().solveBracketed(h, -1, 1);
+
+    ASSERT_TRUE(res.root.has_value());
+    ASSERT_NEAR(0.3, res.root.value(), EPS);
+}
+
+
+// All-roots solver tests.
+TEST(TestPolyRoots, Roots)
+{
+    TFactory func_factory;
+
+    // (x - 1)(x - 2)(x + 3)(x^2 + 1) x^2.
+    VectOfDouble c_v = polyMultiplication({ -1, 1 }, { -2, 1 });
+    c_v = polyMultiplication(c_v, { 3, 1 });
+    c_v = polyMultiplication(c_v, { 1, 0, 1 });
+    c_v = polyMultiplication(c_v, { 0, 0, 1 });
+
+    auto f = func_factory.createObject("polynomial", c_v);
+    auto roots = getPolyRoots(*f);
+
+    std::vector<std::complex<double>> expected = { 0.0, 0.0, 1.0, 2.0, -3.0,
+                                                   { 0, 1 }, { 0, -1 } };
+    ASSERT_EQ(expected.size(), roots.size());
+
+    // Every root is close to one of the expected roots and inside its disc.
+    for (const auto& root : roots) {
+        double dist = HUGE_VAL;
+        for (const auto& z : expected) {
+            dist = std::min(dist, std::abs(root.val - z));
+        }
+
+        ASSERT_GE(root.error, dist);
+        ASSERT_GT(1e-10, root.error);
+    }
+
+    ASSERT_THROW(getPolyRoots(*func_factory.createObject("exp")),
+                 std::logic_error);
+    ASSERT_THROW(getPolyRoots(*func_factory.createObject("const", 0)),
+                 std::logic_error);
+}
+
+TEST(TestPolyRoots, Random)
+{
+    TFactory func_factory;
+    std::srand(static_cast<unsigned int>(time(0)));
+
+    for (unsigned i = 0; i < ITER_NUM; i++) {
+        // Distinct real roots.
+        VectOfDouble c_v = { 1 };
+        VectOfDouble expected;
+        for (unsigned j = 0; j < 12; j++) {
+            double r = j + (std::rand() % 100) / 200.0 - 6.0;
+            expected.push_back(r);
+            c_v = polyMultiplication(c_v, { -r, 1 });
+        }
+
+        auto f = func_factory.createObject("polynomial", c_v);
+        auto roots = getPolyRoots(*f);
+        ASSERT_EQ(expected.size(), roots.size());
+
+        std::sort(roots.begin(), roots.end(),
+        [](const TPolyRoot& lhs, const TPolyRoot& rhs)
+        {
+            return lhs.val.real() < rhs.val.real();
+        });
+
+        for (unsigned j = 0; j < expected.size(); j++) {
+            ASSERT_GE(roots[j].error, std::abs(roots[j].val - expected[j]));
+            ASSERT_NEAR(expected[j], roots[j].val.real(), 1e-6);
+        }
+    }
+}
+
+TEST(TestPolyRoots, Sturm)
+{
+    TFactory func_factory;
+
+    // (x - 1)(x - 2)(x + 3)(x^2 + 1)(x - 0.5)^2.
+    VectOfDouble c_v = polyMultiplication({ -1, 1 }, { -2, 1 });
+    c_v = polyMultiplication(c_v, { 3, 1 });
+    c_v = polyMultiplication(c_v, { 1, 0, 1 });
+    c_v = polyMultiplication(c_v, { 0.25, -1, 1 });
+
+    auto f = func_factory.createObject("polynomial", c_v);
+    TSturmSequence sturm(*f);
+
+    ASSERT_EQ(4, sturm.getRootsNum(-HUGE_VAL, HUGE_VAL));
+    ASSERT_EQ(2, sturm.getRootsNum(0, 1.5));
+    ASSERT_EQ(0, sturm.getRootsNum(1, 1.5));
+    ASSERT_EQ(1, sturm.getRootsNum(0.9, 1));
+    ASSERT_EQ(0, sturm.getRootsNum(-2.5, 0));
+
+    auto intervals = sturm.isolateRoots();
+    ASSERT_EQ(4, intervals.size());
+
+    VectOfDouble expected = { -3, 0.5, 1, 2 };
+    for (unsigned i = 0; i < intervals.size(); i++) {
+        ASSERT_EQ(1, intervals[i].roots_num);
+        ASSERT_LT(intervals[i].a, expected[i]);
+        ASSERT_GE(intervals[i].b, expected[i]);
+
+        if (i > 0) {
+            ASSERT_LE(intervals[i - 1].b, intervals[i].a);
+        }
+    }
+
+    // One bracketed solve per interval with the simple root.
+    for (unsigned i : { 0, 2, 3 }) {
+        auto eq_root = EqSolver().solveEquation(*f,
+                                                intervals[i].a,
+                                                intervals[i].b);
+
+        ASSERT_TRUE(eq_root.has_value());
+        ASSERT_NEAR(expected[i], eq_root.value(), EPS);
+    }
+
+    // Random distinct roots, four of them are negative and none is zero.
+    std::srand(static_cast<unsigned int>(time(0)));
+
+    for (unsigned i = 0; i < ITER_NUM; i++) {
+        VectOfDouble g_v = { 1 };
+        for (unsigned j = 0; j < 8; j++) {
+            double r = j + (std::rand() % 100) / 200.0 - 3.75;
+            g_v = polyMultiplication(g_v, { -r, 1 });
+        }
+
+        auto g = func_factory.createObject("polynomial", g_v);
+        ASSERT_EQ(8, TSturmSequence(*g).isolateRoots().size());
+        ASSERT_EQ(4, TSturmSequence(*g).getRootsNum(-HUGE_VAL, 0));
+    }
+}
+
+
+// Parallel solver tests.
+TEST(TestThreadPool, ParallelFor)
+{
+    TThreadPool pool(4);
+    ASSERT_EQ(4, pool.getThreadsNum());
+
+    // Costs of the iterations differ a lot.
+    std::vector<unsigned> visits(10000, 0);
+    std::vector<double> sums(visits.size(), 0);
+    pool.parallelFor(visits.size(),
+    [&](std::size_t i, unsigned worker)
+    {
+        ASSERT_GT(4, worker);
+        visits[i]++;
+
+        unsigned len = i % 100 == 0 ? 10000 : 10;
+        for (unsigned j = 0; j < len; j++) {
+            sums[i] += j;
+        }
+    });
+
+    for (unsigned i = 0; i < visits.size(); i++) {
+        ASSERT_EQ(1, visits[i]);
+    }
+
+    // The pool is reused, exceptions are passed to the caller.
+    ASSERT_THROW(pool.parallelFor(100,
+                 [](std::size_t i, unsigned worker)
+                 {
+                     if (i == 57) {
+                         throw std::runtime_error("Error");
+                     }
+                 }, 8),
+                 std::runtime_error);
+
+    pool.parallelFor(0,
+    [](std::size_t i, unsigned worker)
+    {
+        FAIL();
+    });
+}
+
+TEST(TestBatchSolver, Solve)
+{
+    TFactory func_factory;
+    std::srand(static_cast<unsigned int>(time(0)));
+
+    // (x - r1)(x - r2) and exponents without roots.
+    std::vector<VectOfDouble> coeff_vects;
+    std::vector<std::unique_ptr<IPolynomial>> functions;
+    for (unsigned i = 0; i < 200; i++) {
+        double r1 = std::rand() % MAXRAND + 0.5;
+        double r2 = -(std::rand() % MAXRAND) - 0.5;
+        coeff_vects.push_back({ 0, r1 * r2, -(r1 + r2), 1 });
+
+        if (i % 10 == 0) {
+            coeff_vects.back() = { 1 };
+        }
+
+        functions.push_back(std::make_unique<IPolynomial>(coeff_vects.back()));
+    }
+
+    EqSolver solver(1000, 1, EPS, EqSolver::Method::Newton);
+    BatchSolver batch_solver(solver, 3);
+
+    std::vector<std::optional<double>> roots(coeff_vects.size());
+    std::vector<std::optional<double>> f_roots(coeff_vects.size());
+    batch_solver.solveEquations(coeff_vects.begin(),
+                                coeff_vects.end(),
+                                roots.data());
+    batch_solver.solveEquations(functions.begin(),
+                                functions.end(),
+                                f_roots.data(),
+                                4);
+
+    for (unsigned i = 0; i < roots.size(); i++) {
+        auto eq_root = solver.solveEquation(*functions[i]);
+
+        ASSERT_EQ(eq_root, roots[i]);
+        ASSERT_EQ(eq_root, f_roots[i]);
+    }
+
+    // Functions of the factory and of the operators.
+    auto x = func_factory.createObject("ident");
+    auto c = func_factory.createObject("const", 4.0);
+    auto e = func_factory.createObject("exp");
+    auto x2 = (*x) * (*x);
+    std::vector<std::unique_ptr<TFunction>> composites;
+    composites.push_back((*x2) - (*c));
+    composites.push_back((*e) - (*c));
+    composites.push_back((*x) * (*e));
+
+    std::vector<std::optional<double>> c_roots(composites.size());
+    batch_solver.solveEquations(composites.begin(),
+                                composites.end(),
+                                c_roots.data());
+
+    ASSERT_NEAR(2, c_roots[0].value(), EPS);
+    ASSERT_NEAR(log(4), c_roots[1].value(), EPS);
+    ASSERT_NEAR(0, c_roots[2].value(), EPS);
+}
+
+TEST(TestBatchSolver, MultiStart)
+{
+    TFactory func_factory;
+
+    // Gradient descent from x = 1 fails for x^3 - x - 3.
+    auto f = func_factory.createObject("polynomial",
+                                       VectOfDouble({ -3, -1, 0, 1 }));
+    ASSERT_FALSE(EqSolver().solveEquation(*f).has_value());
+
+    MultiStartSolver multi_solver(EqSolver(), 16, 0.01, 2);
+    auto res = multi_solver.solveEquation(*f, -10, 10);
+
+    ASSERT_TRUE(res.root.has_value());
+    ASSERT_GT(EPS, std::abs((*f)(res.root.value())));
+    ASSERT_TRUE(res.roots.empty());
+
+    // All roots of (x - 1)(x - 2)(x + 3).
+    VectOfDouble c_v = polyMultiplication({ -1, 1 }, { -2, 1 });
+    c_v = polyMultiplication(c_v, { 3, 1 });
+    auto g = func_factory.createObject("polynomial", c_v);
+
+    MultiStartSolver newton_solver(EqSolver(1000,
+                                            1,
+                                            EPS,
+                                            EqSolver::Method::Newton),
+                                   64,
+                                   0.01,
+                                   3);
+    res = newton_solver.solveEquation(*g, -5, 5, true);
+
+    ASSERT_TRUE(res.root.has_value());
+    ASSERT_EQ(3, res.roots.size());
+    ASSERT_NEAR(-3, res.roots[0], EPS);
+    ASSERT_NEAR(1, res.roots[1], EPS);
+    ASSERT_NEAR(2, res.roots[2], EPS);
+
+    // The stop flag interrupts the solver.
+    std::atomic<bool> stop_flag(true);
+    EqSolver solver;
+    solver.setStopFlag(&stop_flag);
+    ASSERT_FALSE(solver.solveEquation(*g).has_value());
+}
+
+
+// Trajectory recording tests.
+TEST(TestTrajectory, Record)
+{
+    // The ring buffer keeps the last iterates.
+    double buffer[4];
+    TTrajectory trajectory(buffer, 4);
+    for (int i = 0; i < 10; i++) {
+        trajectory.push(i);
+    }
+
+    ASSERT_EQ(4u, trajectory.getSize());
+    ASSERT_EQ(10u, trajectory.getTotalNum());
+    for (std::size_t i = 0; i < trajectory.getSize(); i++) {
+        ASSERT_EQ(6 + i, trajectory[i]);
+    }
+
+    TFactory func_factory;
+    auto f = func_factory.createObject("polynomial", VectOfDouble({ -4, 0, 1 }));
+
+    for (auto method : { EqSolver::Method::GradientDescent,
+                         EqSolver::Method::Newton }) {
+
+        // All iterates fit into the buffer.
+        double full_buffer[1000];
+        TTrajectory full_trajectory(full_buffer, 1000);
+
+        EqSolver solver(1000, 1, EPS, method);
+        solver.setTrajectory(&full_trajectory);
+        auto eq_root = solver.solveEquation(*f);
+
+        ASSERT_TRUE(eq_root.has_value());
+        ASSERT_NEAR(2, eq_root.value(), EPS);
+        ASSERT_EQ(full_trajectory.getSize(), full_trajectory.getTotalNum());
+        ASSERT_LT(1u, full_trajectory.getSize());
+        ASSERT_EQ(1, full_trajectory[0]);
+        ASSERT_EQ(eq_root.value(),
+                  full_trajectory[full_trajectory.getSize() - 1]);
+
+        // Only the last iterates are kept.
+        double last_buffer[2];
+        TTrajectory last_trajectory(last_buffer, 2);
+        solver.setTrajectory(&last_trajectory);
+        eq_root = solver.solveEquation(*f);
+
+        ASSERT_EQ(full_trajectory.getTotalNum(),
+                  last_trajectory.getTotalNum());
+        ASSERT_EQ(full_trajectory[full_trajectory.getSize() - 2],
+                  last_trajectory[0]);
+        ASSERT_EQ(eq_root.value(), last_trajectory[1]);
+    }
+
+    // The best points of Brent's method.
+    double brent_buffer[100];
+    TTrajectory brent_trajectory(brent_buffer, 100);
+    EqSolver solver(100, 1, EPS);
+    solver.setTrajectory(&brent_trajectory);
+    auto res = solver.solveBracketed(*f, 0, 3);
+
+    ASSERT_TRUE(res.root.has_value());
+    ASSERT_LT(0u, brent_trajectory.getSize());
+    ASSERT_EQ(res.root.value(),
+              brent_trajectory[brent_trajectory.getSize() - 1]);
+}
+
+TEST(TestTrajectory, Workers)
+{
+    TFactory func_factory;
+    auto f = func_factory.createObject("polynomial", VectOfDouble({ -4, 0, 1 }));
+    auto one = func_factory.createObject("const", 1.0);
+
+    // The workers of the thread pools do not record into the trajectory of
+    // the prototype.
+    double buffer[100];
+    TTrajectory trajectory(buffer, 100);
+    EqSolver solver(1000, 1, EPS, EqSolver::Method::Newton);
+    solver.setTrajectory(&trajectory);
+
+    std::vector<VectOfDouble> coeff_vects(100, VectOfDouble({ 0, -4, 0, 1 }));
+    std::vector<std::optional<double>> roots(coeff_vects.size());
+    BatchSolver(solver, 3).solveEquations(coeff_vects.begin(),
+                                          coeff_vects.end(),
+                                          roots.data());
+
+    auto res = MultiStartSolver(solver, 16, 0.01, 3).solveEquation(*f,
+                                                                    -5,
+                                                                    5,
+                                                                    true);
+
+    std::vector<double> params = { -1, 0, 1, 2 };
+    auto points = ContinuationSolver(solver, 2, EPS, 3).solveSweep(*f,
+                                                                   *one,
+                                                                   params);
+
+    ASSERT_NEAR(2, roots[0].value(), EPS);
+    ASSERT_EQ(2, res.roots.size());
+    ASSERT_TRUE(points[0].root.has_value());
+    ASSERT_EQ(0u, trajectory.getTotalNum());
+
+    // The prototype still records.
+    ASSERT_TRUE(solver.solveEquation(*f).has_value());
+    ASSERT_LT(0u, trajectory.getTotalNum());
+}
+
+
+// Line search tests.
+TEST(TestLineSearch, EqSolv)
+{
+    TFactory func_factory;
+    auto f = func_factory.createObject("polynomial", VectOfDouble({ -4, 0, 1 }));
+
+    unsigned evals_num = 0;
+    IPolynomial g(
+    [&evals_num](double x)
+    {
+        evals_num++;
+        return exp(x) - 10;
+    },
+    [&evals_num](double x)
+    {
+        evals_num++;
+        return exp(x);
+    },
+    [&evals_num](double x)
+    {
+        evals_num++;
+        return TDual(exp(x) - 10, exp(x));
+    });
+
+    // The steps out of the domain of sqrt(x) - 0.1 are rejected.
+    IPolynomial h(
+    [](double x)
+    {
+        return sqrt(x) - 0.1;
+    },
+    [](double x)
+    {
+        return 0.5 / sqrt(x);
+    },
+    [](double x)
+    {
+        return TDual(sqrt(x) - 0.1, 0.5 / sqrt(x));
+    });
+
+    std::vector<unsigned> evals_nums;
+    for (auto line_search : { EqSolver::LineSearch::Ternary,
+                              EqSolver::LineSearch::GoldenSection,
+                              EqSolver::LineSearch::Backtracking }) {
+
+        EqSolver solver;
+        solver.setLineSearch(line_search);
+
+        auto eq_root = solver.solveEquation(*f);
+        ASSERT_TRUE(eq_root.has_value());
+        ASSERT_NEAR(2, eq_root.value(), EPS);
+
+        evals_num = 0;
+        eq_root = solver.solveEquation(g);
+        ASSERT_TRUE(eq_root.has_value());
+        ASSERT_NEAR(log(10), eq_root.value(), EPS);
+        evals_nums.push_back(evals_num);
+
+        if (line_search != EqSolver::LineSearch::Ternary) {
+            eq_root = solver.solveEquation(h);
+            ASSERT_TRUE(eq_root.has_value());
+            ASSERT_NEAR(0.01, eq_root.value(), EPS);
+        }
+    }
+
+    // The searches from the adaptive bracket need much fewer evaluations.
+    ASSERT_GT(evals_nums[0], 10 * evals_nums[1]);
+    ASSERT_GT(evals_nums[0], 10 * evals_nums[2]);
+}
+
+
+// Solver statistics tests.
+TEST(TestStats, Solve)
+{
+    unsigned evals_num = 0;
+    unsigned derivs_num = 0;
+    IPolynomial f(
+    [&evals_num](double x)
+    {
+        evals_num++;
+        return exp(x) - 10;
+    },
+    [&evals_num, &derivs_num](double x)
+    {
+        evals_num++;
+        derivs_num++;
+        return exp(x);
+    },
+    [&evals_num, &derivs_num](double x)
+    {
+        evals_num++;
+        derivs_num++;
+        return TDual(exp(x) - 10, exp(x));
+    });
+
+    for (auto method : { EqSolver::Method::GradientDescent,
+                         EqSolver::Method::Newton }) {
+
+        double buffer[1];
+        TTrajectory trajectory(buffer, 1);
+        EqSolver solver(1000, 1, EPS, method);
+        solver.setTrajectory(&trajectory);
+
+        evals_num = 0;
+        derivs_num = 0;
+        auto res = solver.solveWithStats(f);
+
+        ASSERT_TRUE(res.root.has_value());
+        ASSERT_NEAR(log(10), res.root.value(), EPS);
+        ASSERT_EQ(evals_num, res.evals_num);
+        ASSERT_EQ(derivs_num, res.derivs_num);
+        ASSERT_EQ(trajectory.getTotalNum(), res.iters_num);
+        ASSERT_GT(EPS, res.residual);
+        ASSERT_LE(0, res.time);
+        ASSERT_EQ(0, res.nan_restarts_num);
+
+        if (method == EqSolver::Method::GradientDescent) {
+            ASSERT_LT(0u, res.line_search_iters_num);
+        }
+    }
+
+    // Brent's method evaluates only the values.
+    evals_num = 0;
+    derivs_num = 0;
+    auto res = EqSolver(100, 1, EPS).solveBracketed(f, 0, 5);
+
+    ASSERT_TRUE(res.root.has_value());
+    ASSERT_EQ(evals_num, res.evals_num);
+    ASSERT_EQ(0, res.derivs_num);
+    ASSERT_LT(0u, res.iters_num);
+    ASSERT_DOUBLE_EQ(std::abs(exp(res.root.value()) - 10), res.residual);
+
+    // The steps out of the domain of sqrt(x) - 0.1 give NaN.
+    IPolynomial g(
+    [](double x)
+    {
+        return sqrt(x) - 0.1;
+    },
+    [](double x)
+    {
+        return 0.5 / sqrt(x);
+    },
+    [](double x)
+    {
+        return TDual(sqrt(x) - 0.1, 0.5 / sqrt(x));
+    });
+
+    EqSolver g_solver;
+    g_solver.setLineSearch(EqSolver::LineSearch::GoldenSection);
+    res = g_solver.solveWithStats(g);
+    ASSERT_TRUE(res.root.has_value());
+    ASSERT_LT(0u, res.nan_restarts_num);
+
+    // The aggregate counters.
+    auto& counters = EqSolver::getCounters();
+    counters.reset();
+    res = EqSolver().solveWithStats(f);
+    auto g_res = g_solver.solveWithStats(g);
+    ASSERT_TRUE(g_res.root.has_value());
+
+#ifdef EQSOLVER_STATS
+    ASSERT_EQ(2, counters.solves_num);
+    ASSERT_EQ(0, counters.failures_num);
+    ASSERT_EQ(res.evals_num + g_res.evals_num, counters.evals_num);
+    ASSERT_EQ(res.iters_num + g_res.iters_num, counters.iters_num);
+#else
+    ASSERT_EQ(0, counters.solves_num);
+    ASSERT_EQ(0, counters.evals_num);
+#endif
+}
+
+
+// Asynchronous solve tests.
+TEST(TestAsync, Solve)
+{
+    TFactory func_factory;
+    auto f = func_factory.createObject("polynomial", VectOfDouble({ -4, 0, 1 }));
+
+    auto future = EqSolver().solveAsync(*f);
+    auto res = future.get();
+
+    ASSERT_TRUE(res.root.has_value());
+    ASSERT_NEAR(2, res.root.value(), EPS);
+    ASSERT_FALSE(res.stopped);
+    ASSERT_EQ(res.root.value(), res.best_x);
+    ASSERT_EQ(res.residual, res.best_residual);
+
+    // Slow evaluations of x^2 - 4, so the deadline stops the iterations.
+    IPolynomial g(
+    [](double x)
+    {
+        usleep(1000);
+        return x * x - 4;
+    },
+    [](double x)
+    {
+        usleep(1000);
+        return 2 * x;
+    },
+    [](double x)
+    {
+        usleep(1000);
+        return TDual(x * x - 4, 2 * x);
+    });
+
+    EqSolver solver;
+    solver.setLineSearch(EqSolver::LineSearch::Ternary);
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(20);
+    res = solver.solveAsync(g, deadline).get();
+
+    ASSERT_FALSE(res.root.has_value());
+    ASSERT_TRUE(res.stopped);
+    ASSERT_LT(0u, res.iters_num);
+    ASSERT_GE(3, res.best_residual);
+    ASSERT_DOUBLE_EQ(std::abs(res.best_x * res.best_x - 4), res.best_residual);
+
+    // Cancellation before the first iteration.
+    std::atomic<bool> cancel(true);
+    res = EqSolver().solveAsync(*f, deadline, &cancel).get();
+
+    ASSERT_FALSE(res.root.has_value());
+    ASSERT_TRUE(res.stopped);
+    ASSERT_EQ(0, res.iters_num);
+    ASSERT_TRUE(std::isnan(res.best_x));
+
+    // The deadline of the synchronous solve.
+    solver.setDeadline(std::chrono::steady_clock::now());
+    ASSERT_FALSE(solver.solveEquation(*f).has_value());
+    ASSERT_TRUE(solver.solveWithStats(*f).stopped);
+
+    // Concurrent solves do not record into the trajectory of the solver.
+    double buffer[100];
+    TTrajectory trajectory(buffer, 100);
+    EqSolver recorder;
+    recorder.setTrajectory(&trajectory);
+
+    std::vector<std::future<TSolveResult>> futures;
+    for (int i = 0; i < 4; i++) {
+        futures.push_back(recorder.solveAsync(*f));
+    }
+
+    for (auto& future : futures) {
+        ASSERT_NEAR(2, future.get().root.value(), EPS);
+    }
+
+    ASSERT_EQ(0u, trajectory.getTotalNum());
+    ASSERT_TRUE(recorder.solveEquation(*f).has_value());
+    ASSERT_LT(0u, trajectory.getTotalNum());
+}
+
+
+// Continuation sweep tests.
+TEST(TestContinuation, Sweep)
+{
+    TFactory func_factory;
+    auto one = func_factory.createObject("const", 1.0);
+
+    std::vector<double> params;
+    for (int i = 0; i <= 2000; i++) {
+        params.push_back(-10 + i * 0.01);
+    }
+
+    // x^3 + x + p has one root for every p.
+    auto f = func_factory.createObject("polynomial",
+                                       VectOfDouble({ 0, 1, 0, 1 }));
+    EqSolver solver(1000, 1, EPS, EqSolver::Method::Newton);
+
+    for (std::size_t chunk_size : { 10000, 50 }) {
+        ContinuationSolver cont_solver(solver, chunk_size, EPS, 2);
+        auto points = cont_solver.solveSweep(*f, *one, params);
+
+        ASSERT_EQ(params.size(), points.size());
+
+        unsigned iters_num = 0;
+        unsigned cold_iters_num = 0;
+        for (std::size_t i = 0; i < params.size(); i++) {
+            ASSERT_TRUE(points[i].root.has_value());
+            ASSERT_FALSE(points[i].fold);
+
+            double x = points[i].root.value();
+            ASSERT_GT(EPS, std::abs(x * x * x + x + params[i]));
+
+            iters_num += points[i].iters_num;
+
+            auto h = func_factory.createObject(
+                    "polynomial", VectOfDouble({ params[i], 1, 0, 1 }));
+            cold_iters_num += solver.solveWithStats(*h).iters_num;
+        }
+
+        // The warm starts need fewer iterations.
+        ASSERT_GT(cold_iters_num, 2 * iters_num);
+    }
+
+    // The branch of x^3 - x + p from p = -1 turns back at the fold
+    // p = 2 / (3 sqrt(3)), then the solutions are on the other branch.
+    auto g = func_factory.createObject("polynomial",
+                                       VectOfDouble({ 0, -1, 0, 1 }));
+    double fold_p = 2 / (3 * sqrt(3));
+
+    params.clear();
+    for (int i = 0; i <= 200; i++) {
+        params.push_back(-1 + i * 0.01);
+    }
+
+    ContinuationSolver cont_solver(solver, 10000, EPS, 1);
+    auto points = cont_solver.solveSweep(*g, *one, params);
+
+    for (std::size_t i = 0; i < params.size(); i++) {
+        ASSERT_TRUE(points[i].root.has_value());
+
+        double x = points[i].root.value();
+        ASSERT_GT(EPS, std::abs(x * x * x - x + params[i]));
+        ASSERT_EQ(params[i] > fold_p and params[i - 1] < fold_p,
+                  points[i].fold);
+        ASSERT_EQ(params[i] < fold_p, x > 0);
+    }
+}
+
+
+// Lock-step batch Newton tests.
+TEST(TestPolyBatch, Solve)
+{
+    // Fixed coefficients from the generator with the sequence given by the
+    // standard. Odd degree, so every equation has a root. The number of
+    // equations is not a multiple of the number of lanes.
+    std::minstd_rand gen(1);
+    const std::size_t size = 7;
+    const std::size_t n = 1003;
+    std::vector<double> coeffs(n * size, 0);
+    for (std::size_t i = 0; i < n; i++) {
+        for (std::size_t j = 1; j < size; j++) {
+            coeffs[i * size + j] = gen() % 200 / 10.0 - 10.0;
+        }
+
+        if (coeffs[i * size + size - 1] == 0) {
+            coeffs[i * size + size - 1] = 1;
+        }
+    }
+
+    std::vector<std::optional<double>> roots(n);
+    PolyBatchSolver(1000, 1, EPS).solveEquations(coeffs.data(),
+                                                 size,
+                                                 n,
+                                                 roots.data());
+
+    for (std::size_t i = 0; i < n; i++) {
+        IPolynomial f(VectOfDouble(coeffs.begin() + i * size,
+                                   coeffs.begin() + (i + 1) * size));
+
+        ASSERT_TRUE(roots[i].has_value());
+        ASSERT_GT(EPS, std::abs(f(roots[i].value())));
+    }
+
+    // Exponent, cycling Newton iterations, no root.
+    const VectOfDouble cubic = { 0, 2, -2, 0, 1 };
+    std::vector<double> mixed;
+    for (const VectOfDouble& c_v : { VectOfDouble({ 1, 0, 1, 0, 0 }),
+                                     cubic,
+                                     VectOfDouble({ 0, 1, 0, 1, 0 }) }) {
+
+        mixed.insert(mixed.end(), c_v.begin(), c_v.end());
+    }
+
+    std::vector<std::optional<double>> mixed_roots(3);
+    PolyBatchSolver(1000, 0, EPS).solveEquations(mixed.data(),
+                                                 5,
+                                                 3,
+                                                 mixed_roots.data());
+
+    // exp(x) + x.
+    ASSERT_TRUE(mixed_roots[0].has_value());
+    ASSERT_NEAR(-0.567143, mixed_roots[0].value(), EPS);
+
+    // x^3 - 2x + 2, pure Newton iterations cycle from 0.
+    ASSERT_TRUE(mixed_roots[1].has_value());
+    ASSERT_GT(EPS, std::abs(IPolynomial(cubic)(mixed_roots[1].value())));
+
+    // x^2 + 1.
+    ASSERT_FALSE(mixed_roots[2].has_value());
+
+    ASSERT_THROW(PolyBatchSolver().solveEquations(mixed.data(),
+                                                  0,
+                                                  3,
+                                                  mixed_roots.data()),
+                 std::logic_error);
+}
+
+
+// Interval arithmetic tests.
+TEST(TestInterval, Eval)
+{
+    TFactory func_factory;
+    std::srand(static_cast<unsigned int>(time(0)));
+
+    auto f = func_factory.createObject("polynomial", genPolyCoeffs());
+    auto g = func_factory.createObject("exp");
+    auto h = func_factory.createObject("ident");
+
+    // Composite function with the exponent part of the basic function.
+    auto fg = (*f) * (*g);
+    auto hh = (*h) * (*h);
+    auto num = (*fg) + (*h);
+    auto den = (*hh) + (*g);
+    auto k = (*num) / (*den);
+
+    const TFunction* funcs[] = { f.get(), k.get() };
+    for (const TFunction* func : funcs) {
+
+        TIntervalFunction func_ext(*func);
+
+        for (unsigned i = 0; i < ITER_NUM; i++) {
+            double lo = std::rand() % 200 / 100.0 - 1;
+            TInterval x(lo, lo + std::rand() % 100 / 100.0);
+            TIntervalDual res = func_ext.getValDeriv(x);
+
+            ASSERT_EQ(res.val.lo, func_ext(x).lo);
+            ASSERT_EQ(res.val.hi, func_ext(x).hi);
+
+            // The enclosures contain the values at the points. The last
+            // point may be rounded out of the interval.
+            for (unsigned j = 0; j <= 10; j++) {
+                double t = std::min(x.lo + (x.hi - x.lo) * j / 10, x.hi);
+                TDual f_t = func->getValDeriv(t);
+
+                ASSERT_TRUE(res.val.contains(f_t.val));
+                ASSERT_TRUE(res.deriv.contains(f_t.deriv));
+            }
+        }
+    }
+
+    // Opaque functions have no interval extension.
+    IPolynomial l(
+    [](double x)
+    {
+        return x;
+    },
+    [](double)
+    {
+        return 1.0;
+    },
+    [](double x)
+    {
+        return TDual(x, 1);
+    });
+
+    auto m = (*f) + l;
+    ASSERT_THROW(TIntervalFunction { *m }, std::logic_error);
+}
+
+TEST(TestInterval, EqSolv)
+{
+    TFactory func_factory;
+    IntervalSolver solver(1e-12);
+
+    // (x - 1)(x - 2)(x + 3).
+    VectOfDouble c_v = polyMultiplication({ -1, 1 }, { -2, 1 });
+    c_v = polyMultiplication(c_v, { 3, 1 });
+    auto f = func_factory.createObject("polynomial", c_v);
+
+    auto res = solver.solveEquation(*f, -10, 10);
+    ASSERT_TRUE(res.complete);
+    ASSERT_EQ(3, res.roots.size());
+
+    double f_roots[] = { -3, 1, 2 };
+    for (std::size_t i = 0; i < 3; i++) {
+        ASSERT_TRUE(res.roots[i].unique);
+        ASSERT_TRUE(res.roots[i].x.contains(f_roots[i]));
+        ASSERT_GE(1e-12, res.roots[i].x.getWidth());
+    }
+
+    // x exp(x) - 1, the root is the omega constant.
+    auto g = func_factory.createObject("ident");
+    auto h = func_factory.createObject("exp");
+    auto one = func_factory.createObject("const", 1.0);
+    auto gh = (*g) * (*h);
+    auto k = (*gh) - (*one);
+
+    res = solver.solveEquation(*k, -5, 5);
+    ASSERT_TRUE(res.complete);
+    ASSERT_EQ(1, res.roots.size());
+    ASSERT_TRUE(res.roots[0].unique);
+    ASSERT_TRUE(res.roots[0].x.contains(0.56714329040978384));
+
+    // exp(x) - 10 given by the basic function.
+    IPolynomial l(VectOfDouble({ 1, -10 }));
+    res = solver.solveEquation(l, 0, 5);
+    ASSERT_EQ(1, res.roots.size());
+    ASSERT_TRUE(res.roots[0].unique);
+    ASSERT_TRUE(res.roots[0].x.contains(log(10)));
+
+    // The double root can not be proven.
+    auto m = func_factory.createObject("polynomial",
+                                       VectOfDouble({ 1, -2, 1 }));
+    res = IntervalSolver(1e-6).solveEquation(*m, -10, 10);
+    ASSERT_TRUE(res.complete);
+    ASSERT_LT(0u, res.roots.size());
+    for (const auto& root : res.roots) {
+        ASSERT_FALSE(root.unique);
+        ASSERT_NEAR(1, root.x.getMid(), 0.001);
+    }
+
+    // No roots.
+    auto n = func_factory.createObject("polynomial",
+                                       VectOfDouble({ 1, 0, 1 }));
+    res = solver.solveEquation(*n, -10, 10);
+    ASSERT_TRUE(res.complete);
+    ASSERT_TRUE(res.roots.empty());
+
+    // The boxes are over.
+    res = IntervalSolver(1e-12, 2).solveEquation(*f, -10, 10);
+    ASSERT_FALSE(res.complete);
+
+    ASSERT_THROW(solver.solveEquation(*f, 0, HUGE_VAL), std::logic_error);
+    ASSERT_THROW(solver.solveEquation(*f, 1, 0), std::logic_error);
+}
+
+
+// Solve cache tests.
+TEST(TestSolveCache, Hash)
+{
+    TFactory func_factory;
+
+    auto f = func_factory.createObject("polynomial",
+                                       VectOfDouble({ 0, -2, 0, 1 }));
+    auto f0 = func_factory.createObject("polynomial",
+                                        VectOfDouble({ -0.0, -2, 0, 1, 0 }));
+    auto g = func_factory.createObject("exp");
+    auto h = func_factory.createObject("polynomial",
+                                       VectOfDouble({ 0, -2, 0, 1.5 }));
+
+    // Equal coefficients up to the trailing zeros and the sign of zero.
+    ASSERT_TRUE(getFunctionHash(*f).has_value());
+    ASSERT_EQ(getFunctionHash(*f), getFunctionHash(*f0));
+    ASSERT_NE(getFunctionHash(*f), getFunctionHash(*h));
+
+    // The operands of the commutative operations are unordered.
+    auto fg = (*f) * (*g);
+    auto gf = (*g) * (*f0);
+    auto f_g = (*f) / (*g);
+    auto g_f = (*g) / (*f);
+    ASSERT_EQ(getFunctionHash(*fg), getFunctionHash(*gf));
+    ASSERT_NE(getFunctionHash(*f_g), getFunctionHash(*g_f));
+    ASSERT_NE(getFunctionHash(*fg), getFunctionHash(*f_g));
+
+    // Opaque functions have no hash.
+    IPolynomial l(
+    [](double x)
+    {
+        return x;
+    },
+    [](double)
+    {
+        return 1.0;
+    },
+    [](double x)
+    {
+        return TDual(x, 1);
+    });
+
+    auto m = (*f) + l;
+    ASSERT_FALSE(getFunctionHash(l).has_value());
+    ASSERT_FALSE(getFunctionHash(*m).has_value());
+}
+
+TEST(TestSolveCache, EqSolv)
+{
+    TFactory func_factory;
+
+    std::string path = (std::filesystem::temp_directory_path() /
+                        ("eqsolver-cache-test-" +
+                         std::to_string(getpid()))).string();
+    std::filesystem::remove(path);
+
+    // x^3 - 2x - 5 and the same function built by the operators.
+    auto f = func_factory.createObject("polynomial",
+                                       VectOfDouble({ -5, -2, 0, 1 }));
+    auto p = func_factory.createObject("power", 3);
+    auto q = func_factory.createObject("polynomial",
+                                       VectOfDouble({ -5, -2 }));
+    auto g = (*q) + (*p);
+
+    // Composite functions are IPolynomial built from the functors.
+    const auto& g_poly = dynamic_cast<const IPolynomial&>(*g);
+
+    {
+        TSolveCache cache(path, 100);
+        ASSERT_EQ(128, cache.getCapacity());
+        ASSERT_FALSE(cache.isReadOnly());
+
+        EqSolver solver(1000, 1, 1e-9, EqSolver::Method::Newton);
+        solver.setCache(&cache);
+
+        auto res = solver.solveWithStats(*f);
+        ASSERT_TRUE(res.root.has_value());
+        ASSERT_FALSE(res.cached);
+
+        // The hit costs one evaluation and gives the same root.
+        auto cached_res = solver.solveWithStats(*f);
+        ASSERT_TRUE(cached_res.cached);
+        ASSERT_EQ(1, cached_res.evals_num);
+        ASSERT_EQ(res.root, cached_res.root);
+        ASSERT_GE(1e-9, cached_res.residual);
+
+        // Other settings are other keys.
+        ASSERT_FALSE(solver.solveWithStats(*f, 2).cached);
+        ASSERT_TRUE(solver.solveWithStats(*f, 2).cached);
+
+        EqSolver brent_solver(1000, 1, 1e-9);
+        brent_solver.setCache(&cache);
+        ASSERT_FALSE(brent_solver.solveBracketed(*f, 2, 3).cached);
+        ASSERT_TRUE(brent_solver.solveBracketed(*f, 2, 3).cached);
+
+        // Failed solves are not cached.
+        auto h = func_factory.createObject("polynomial",
+                                           VectOfDouble({ 1, 0, 1 }));
+        ASSERT_FALSE(solver.solveWithStats(*h).root.has_value());
+        ASSERT_FALSE(solver.solveWithStats(*h).cached);
+
+        // Opaque functions are solved without the cache.
+        IPolynomial l(
+        [](double x)
+        {
+            return x - 1;
+        },
+        [](double)
+        {
+            return 1.0;
+        },
+        [](double x)
+        {
+            return TDual(x - 1, 1);
+        });
+
+        ASSERT_FALSE(solver.solveWithStats(l).cached);
+        ASSERT_FALSE(solver.solveWithStats(l).cached);
+    }
+
+    // The next opening of the file reads the roots of the previous one, the
+    // capacity of the file is kept. The equal function built by the
+    // operators has the same key.
+    TSolveCache cache(path, 1 << 20);
+    ASSERT_EQ(128, cache.getCapacity());
+
+    std::vector<std::future<TSolveResult>> results;
+    for (unsigned i = 0; i < 8; i++) {
+        results.push_back(std::async(std::launch::async,
+        [&cache, &g_poly]()
+        {
+            EqSolver solver(1000, 1, 1e-9, EqSolver::Method::Newton);
+            solver.setCache(&cache);
+
+            return solver.solveWithStats(g_poly);
+        }));
+    }
+
+    for (auto& res : results) {
+        TSolveResult r = res.get();
+        ASSERT_TRUE(r.cached);
+        ASSERT_NEAR(2.0945514815423265, r.root.value(), 1e-9);
+    }
+
+    // The file of other kind is rejected.
+    std::filesystem::resize_file(path, 100);
+    ASSERT_THROW(TSolveCache { path }, std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+
+// Evaluation memo tests.
+TEST(TestMemo, Eval)
+{
+    TFactory func_factory;
+
+    auto f = func_factory.createObject("polynomial",
+                                       VectOfDouble({ -2, 0, 1 }));
+    auto g = func_factory.createObject("exp");
+    auto h = (*f) * (*g);
+
+    TEvalMemo<> memo(h.get());
+    ASSERT_EQ(0, memo.getHitRate());
+
+    for (double x : { 0.5, -1.0, 2.0 }) {
+        ASSERT_EQ((*h)(x), memo.getVal(x));
+        ASSERT_EQ((*h)(x), memo.getVal(x));
+
+        // The derivative at the point of the value evaluates only the
+        // derivative, then the slot gives both.
+        TDual d = memo.getValDeriv(x);
+        ASSERT_EQ((*h)(x), d.val);
+        ASSERT_EQ(h->getDeriv(x), d.deriv);
+        ASSERT_EQ(d.deriv, memo.getValDeriv(x).deriv);
+        ASSERT_EQ(d.val, memo.getVal(x));
+    }
+
+    ASSERT_EQ(12, memo.getHitsNum());
+    ASSERT_EQ(3, memo.getEvalsNum());
+    ASSERT_EQ(3, memo.getDerivsNum());
+    ASSERT_DOUBLE_EQ(0.8, memo.getHitRate());
+
+    // The derivative query first evaluates both.
+    TEvalMemo<> deriv_memo(h.get());
+    ASSERT_EQ(h->getValDeriv(2).deriv, deriv_memo.getValDeriv(2).deriv);
+    ASSERT_EQ((*h)(2), deriv_memo.getVal(2));
+    ASSERT_EQ(1, deriv_memo.getEvalsNum());
+    ASSERT_EQ(1, deriv_memo.getDerivsNum());
+    ASSERT_EQ(1, deriv_memo.getHitsNum());
+
+    // The last point memo forgets the previous point.
+    TEvalMemo<1> last_memo(h.get());
+    last_memo.getVal(1);
+    last_memo.getVal(1);
+    last_memo.getVal(2);
+    last_memo.getVal(1);
+    ASSERT_EQ(1, last_memo.getHitsNum());
+    ASSERT_EQ(3, last_memo.getEvalsNum());
+
+    // NaN and the signed zeros are the points too.
+    last_memo.reset(f.get());
+    ASSERT_EQ(0, last_memo.getEvalsNum());
+    ASSERT_TRUE(std::isnan(last_memo.getVal(NAN)));
+    ASSERT_TRUE(std::isnan(last_memo.getVal(NAN)));
+    ASSERT_EQ(-2, last_memo.getVal(0.0));
+    ASSERT_EQ(-2, last_memo.getVal(-0.0));
+    ASSERT_EQ(1, last_memo.getHitsNum());
+}
+
+TEST(TestMemo, EqSolv)
+{
+    TFactory func_factory;
+
+    // x exp(x) - 10 with the stationary point at -1.
+    auto g = func_factory.createObject("exp");
+    auto x = func_factory.createObject("ident");
+    auto c = func_factory.createObject("const", 10.0);
+    auto gx = (*g) * (*x);
+    auto k = (*gx) - (*c);
+    const auto& f = dynamic_cast<const IPolynomial&>(*k);
+
+    EqSolver solver(1000, 1, 1e-6);
+    solver.setLineSearch(EqSolver::LineSearch::Ternary);
+
+    // The memo gives the same iterates.
+    for (double init_x : { 0.0, -1.0 }) {
+        solver.setMemoization(false);
+        auto res = solver.solveWithStats(f, init_x);
+        ASSERT_EQ(0, res.memo_hits_num);
+
+        solver.setMemoization(true);
+        auto memo_res = solver.solveWithStats(f, init_x);
+        ASSERT_EQ(res.root, memo_res.root);
+        ASSERT_EQ(res.iters_num, memo_res.iters_num);
+        ASSERT_EQ(res.evals_num, memo_res.evals_num + memo_res.memo_hits_num);
+        ASSERT_GE(res.derivs_num, memo_res.derivs_num);
+    }
+
+    // The search stalled at the stationary point repeats the same point, so
+    // f is evaluated once.
+    auto res = solver.solveWithStats(f, -1);
+    ASSERT_FALSE(res.root.has_value());
+    ASSERT_EQ(1, res.evals_num);
+    ASSERT_LT(1000, res.memo_hits_num);
+
+    // The memo is cleared for the next solve.
+    ASSERT_EQ(1, solver.solveWithStats(f, -1).evals_num);
+    ASSERT_TRUE(solver.solveWithStats(f, 0).root.has_value());
+}
+
+TEST(TestMemo, LineSearch)
+{
+    TFactory func_factory;
+    auto f = func_factory.createObject("polynomial",
+                                       VectOfDouble({ -2, 0, 0, 1 }));
+    const auto& p = dynamic_cast<const IPolynomial&>(*f);
+
+    // The point accepted by the line search needs only the derivative in
+    // the next iteration.
+    for (auto line_search : { EqSolver::LineSearch::GoldenSection,
+                              EqSolver::LineSearch::Backtracking }) {
+
+        EqSolver solver(1000, 3, 1e-9);
+        solver.setLineSearch(line_search);
+        auto res = solver.solveWithStats(p);
+
+        solver.setMemoization(true);
+        auto memo_res = solver.solveWithStats(p);
+
+        ASSERT_TRUE(memo_res.root.has_value());
+        ASSERT_NEAR(cbrt(2), memo_res.root.value(), 1e-6);
+        ASSERT_EQ(res.root, memo_res.root);
+        ASSERT_EQ(res.iters_num, memo_res.iters_num);
+        ASSERT_LT(0u, memo_res.memo_hits_num);
+        ASSERT_EQ(res.evals_num, memo_res.evals_num + memo_res.memo_hits_num);
+        ASSERT_EQ(res.derivs_num, memo_res.derivs_num);
+    }
+}
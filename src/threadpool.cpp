@@ -0,0 +1,190 @@
+#include "threadpool.hpp"
+
+#include <algorithm>
+
+
+TThreadPool::TThreadPool(unsigned threads_num)
+    : threads_num_ { std::max(1u, threads_num) },
+      ranges_ { new TRange[threads_num_] }
+{
+    // Worker 0 is the thread which calls parallelFor().
+    for (unsigned i = 1; i < threads_num_; i++) {
+        threads_.emplace_back(&TThreadPool::workerLoop, this, i);
+    }
+}
+
+TThreadPool::~TThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+
+    start_cv_.notify_all();
+
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+
+void TThreadPool::workerLoop(unsigned worker)
+{
+    unsigned long long generation = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_cv_.wait(lock,
+            [&]()
+            {
+                return stop_ or generation_ != generation;
+            });
+
+            if (stop_) {
+                return;
+            }
+
+            generation = generation_;
+        }
+
+        runLoop(worker);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            active_num_--;
+        }
+
+        done_cv_.notify_one();
+    }
+}
+
+void TThreadPool::runLoop(unsigned worker)
+{
+    TRange& range = ranges_[worker];
+
+    do {
+        while (true) {
+            std::size_t begin;
+            std::size_t end;
+
+            {
+                std::lock_guard<std::mutex> lock(range.mutex);
+                if (range.begin >= range.end) {
+                    break;
+                }
+
+                begin = range.begin;
+                end = std::min(range.end, begin + grain_);
+                range.begin = end;
+            }
+
+            for (std::size_t i = begin; i < end; i++) {
+                try {
+                    (*body_)(i, worker);
+
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (not error_) {
+                        error_ = std::current_exception();
+                    }
+                }
+            }
+        }
+
+    } while (steal(worker));
+}
+
+bool TThreadPool::steal(unsigned worker)
+{
+    // The largest range is the victim. It may be taken by other workers
+    // before it is locked again, then the search is repeated.
+    while (true) {
+        unsigned victim = worker;
+        std::size_t max_size = 0;
+
+        for (unsigned i = 0; i < threads_num_; i++) {
+            TRange& range = ranges_[i];
+            std::lock_guard<std::mutex> lock(range.mutex);
+
+            if (range.end > range.begin and
+                    range.end - range.begin > max_size) {
+
+                max_size = range.end - range.begin;
+                victim = i;
+            }
+        }
+
+        if (max_size == 0) {
+            return false;
+        }
+
+        TRange& from = ranges_[victim];
+        TRange& to = ranges_[worker];
+
+        // Both ranges are locked at once to avoid deadlocks with the other
+        // thieves.
+        std::unique_lock<std::mutex> lock_from(from.mutex, std::defer_lock);
+        std::unique_lock<std::mutex> lock_to(to.mutex, std::defer_lock);
+        std::lock(lock_from, lock_to);
+
+        if (from.end <= from.begin) {
+            continue;
+        }
+
+        // The back half, the single index is taken too.
+        std::size_t mid = from.begin + (from.end - from.begin) / 2;
+        to.begin = mid;
+        to.end = from.end;
+        from.end = mid;
+
+        return true;
+    }
+}
+
+
+void TThreadPool::parallelFor(std::size_t n,
+                              const Body& body,
+                              std::size_t grain)
+{
+    if (n == 0) {
+        return;
+    }
+
+    // Even split of the indices.
+    for (unsigned i = 0; i < threads_num_; i++) {
+        std::lock_guard<std::mutex> lock(ranges_[i].mutex);
+        ranges_[i].begin = n * i / threads_num_;
+        ranges_[i].end = n * (i + 1) / threads_num_;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        body_ = &body;
+        grain_ = std::max<std::size_t>(1, grain);
+        error_ = nullptr;
+        active_num_ = threads_num_ - 1;
+        generation_++;
+    }
+
+    start_cv_.notify_all();
+
+    runLoop(0);
+
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock,
+        [this]()
+        {
+            return active_num_ == 0;
+        });
+
+        error = error_;
+        body_ = nullptr;
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
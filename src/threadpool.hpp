@@ -0,0 +1,85 @@
+#ifndef THREADPOOL_HEADER
+#define THREADPOOL_HEADER
+
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <memory>
+#include <algorithm>
+#include <cstddef>
+
+
+// Thread pool for parallel loops over index ranges with work stealing. The
+// range of the loop is split between the workers evenly. A worker takes
+// grain indices at a time from the front of its own range and, when the
+// range is empty, steals the back half of the largest range of the other
+// workers. So the load is balanced if the costs of iterations differ a
+// lot, and the workers touch shared state once per grain indices only.
+// The calling thread is one of the workers.
+class TThreadPool
+{
+public:
+    using Body = std::function<void(std::size_t i, unsigned worker)>;
+
+    explicit TThreadPool(unsigned threads_num = getDefaultThreadsNum());
+    ~TThreadPool();
+
+    TThreadPool(const TThreadPool&) = delete;
+    TThreadPool& operator=(const TThreadPool&) = delete;
+
+    // Method to call body(i, worker) for every i in [0, n), where worker is
+    // the index of the calling worker in [0, getThreadsNum()). Blocks until
+    // all calls are done and rethrows the first exception of body. Must not
+    // be called from body.
+    void parallelFor(std::size_t n, const Body& body, std::size_t grain = 1);
+
+    unsigned getThreadsNum() const
+    {
+        return threads_num_;
+    }
+
+    static unsigned getDefaultThreadsNum()
+    {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+private:
+    // Range of the indices of one worker. Ranges are on separate cache
+    // lines, so the workers do not slow down each other.
+    struct alignas(64) TRange
+    {
+        std::mutex mutex;
+        std::size_t begin = 0;
+        std::size_t end = 0;
+    };
+
+    unsigned threads_num_;
+    std::vector<std::thread> threads_;
+    std::unique_ptr<TRange[]> ranges_;
+
+    // State of the current loop.
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    const Body* body_ = nullptr;
+    std::size_t grain_ = 1;
+    unsigned long long generation_ = 0;
+    unsigned active_num_ = 0;
+    bool stop_ = false;
+    std::exception_ptr error_;
+
+    void workerLoop(unsigned worker);
+
+    // Method to run the iterations of the current loop by the worker.
+    void runLoop(unsigned worker);
+
+    // Method to move a part of the other range to the range of the worker.
+    bool steal(unsigned worker);
+};
+
+
+#endif